@@ -54,6 +54,7 @@ using namespace dev::etc;
 
 // Global vars
 bool g_running = false;
+std::atomic<bool> g_rescan = {false};  // Devices enumeration requested (SIGHUP)
 bool g_exitOnError = false;  // Whether or not keccakminer should exit on mining threads errors
 
 condition_variable g_shouldstop;
@@ -160,6 +161,12 @@ public:
             }
             exit(128);
 #undef BACKTRACE_MAX_FRAMES
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+        case SIGHUP:
+            g_rescan = true;
+            g_shouldstop.notify_all();
+            break;
 #endif
         case (999U):
             // Compiler complains about the lack of
@@ -350,10 +357,50 @@ public:
 
         app.add_option("--cpu-devices,--cp-devices", m_CPSettings.devices, "");
 
+        string cpuPolicy = "logical";
+
+        app.add_set("--cpu-policy,--cp-policy", cpuPolicy, {"logical", "core", "numa", "list"}, "",
+            true);
+
+        app.add_option("--cpu-cpus,--cp-cpus", m_CPSettings.cpus, "");
+
+        app.add_flag("--cpu-pool,--cp-pool", m_CPSettings.pool, "");
+
+        app.add_option("--cpu-latency,--cp-latency", m_CPSettings.latency, "", true)
+            ->check(CLI::Range(50, 100000));
+
+        app.add_flag("--cpu-idle,--cp-idle", m_CPSettings.idle, "");
+
+        app.add_option("--cpu-nice,--cp-nice", m_CPSettings.nice, "", true)
+            ->check(CLI::Range(-20, 19));
+
+        app.add_option("--cpu-share,--cp-share", m_CPSettings.share, "", true)
+            ->check(CLI::Range(1, 100));
+
+        app.add_option("--cpu-pressure,--cp-pressure", m_CPSettings.pressure, "", true)
+            ->check(CLI::Range(0, 100));
+
+        app.add_flag("--cpu-counters,--cp-counters", m_CPSettings.counters, "");
+
 #endif
 
         app.add_flag("--noeval", m_FarmSettings.noEval, "");
 
+        app.add_option("--nonce-ledger", m_FarmSettings.nonceLedger, "", true);
+
+        app.add_option("--history", m_FarmSettings.telemetryHistory, "", true)
+            ->check([](const string& spec) -> string {
+                try
+                {
+                    TelemetryHistory::parse(spec);
+                }
+                catch (const std::exception& ex)
+                {
+                    throw CLI::ValidationError("--history", ex.what());
+                }
+                return string("");
+            });
+
         app.add_option("-L,--dag-load-mode", m_FarmSettings.dagLoadMode, "", true)->check(CLI::Range(1));
 
         bool cl_miner = false;
@@ -481,6 +528,17 @@ public:
             m_CUSettings.schedule = 4;
 #endif
 
+#if ETC_KECCAKCPU
+        if (cpuPolicy == "core")
+            m_CPSettings.policy = CpuPolicyEnum::Core;
+        else if (cpuPolicy == "numa")
+            m_CPSettings.policy = CpuPolicyEnum::Numa;
+        else if (cpuPolicy == "list" || m_CPSettings.cpus.size())
+            m_CPSettings.policy = CpuPolicyEnum::List;
+        if (m_CPSettings.policy == CpuPolicyEnum::List && !m_CPSettings.cpus.size())
+            throw std::invalid_argument("--cp-policy list requires --cp-cpus");
+#endif
+
         if (m_FarmSettings.tempStop)
         {
             // If temp threshold set HWMON at least to 1
@@ -505,20 +563,124 @@ public:
         return true;
     }
 
-    void execute()
+    // Detects devices of the types selected on command line
+    void enumDevices(std::map<string, DeviceDescriptor>& _devices)
     {
 #if ETC_KECCAKCL
         if (m_minerType == MinerType::CL || m_minerType == MinerType::Mixed)
-            CLMiner::enumDevices(m_DevicesCollection);
+            CLMiner::enumDevices(_devices);
 #endif
 #if ETC_KECCAKCUDA
         if (m_minerType == MinerType::CUDA || m_minerType == MinerType::Mixed)
-            CUDAMiner::enumDevices(m_DevicesCollection);
+            CUDAMiner::enumDevices(_devices);
 #endif
 #if ETC_KECCAKCPU
         if (m_minerType == MinerType::CPU)
-            CPUMiner::enumDevices(m_DevicesCollection);
+            CPUMiner::enumDevices(_devices, m_CPSettings);
+#endif
+    }
+
+    // Subscribes devices as selected on command line
+    void subscribeDevices(std::map<string, DeviceDescriptor>& _devices)
+    {
+        // Subscribe devices with appropriate Miner Type
+        // Use CUDA first when available then, as second, OpenCL
+
+        // Apply discrete subscriptions (if any)
+#if ETC_KECCAKCUDA
+        if (m_CUSettings.devices.size() &&
+            (m_minerType == MinerType::CUDA || m_minerType == MinerType::Mixed))
+        {
+            for (auto index : m_CUSettings.devices)
+            {
+                if (index < _devices.size())
+                {
+                    auto it = _devices.begin();
+                    std::advance(it, index);
+                    if (!it->second.cuDetected)
+                        throw std::runtime_error("Can't CUDA subscribe a non-CUDA device.");
+                    it->second.subscriptionType = DeviceSubscriptionTypeEnum::Cuda;
+                }
+            }
+        }
 #endif
+#if ETC_KECCAKCL
+        if (m_CLSettings.devices.size() &&
+            (m_minerType == MinerType::CL || m_minerType == MinerType::Mixed))
+        {
+            for (auto index : m_CLSettings.devices)
+            {
+                if (index < _devices.size())
+                {
+                    auto it = _devices.begin();
+                    std::advance(it, index);
+                    if (!it->second.clDetected)
+                        throw std::runtime_error("Can't OpenCL subscribe a non-OpenCL device.");
+                    if (it->second.subscriptionType != DeviceSubscriptionTypeEnum::None)
+                        throw std::runtime_error(
+                            "Can't OpenCL subscribe a CUDA subscribed device.");
+                    it->second.subscriptionType = DeviceSubscriptionTypeEnum::OpenCL;
+                }
+            }
+        }
+#endif
+#if ETC_KECCAKCPU
+        if (m_CPSettings.devices.size() && (m_minerType == MinerType::CPU))
+        {
+            for (auto index : m_CPSettings.devices)
+            {
+                if (index < _devices.size())
+                {
+                    auto it = _devices.begin();
+                    std::advance(it, index);
+                    it->second.subscriptionType = DeviceSubscriptionTypeEnum::Cpu;
+                }
+            }
+        }
+#endif
+
+        // Subscribe all detected devices
+#if ETC_KECCAKCUDA
+        if (!m_CUSettings.devices.size() &&
+            (m_minerType == MinerType::CUDA || m_minerType == MinerType::Mixed))
+        {
+            for (auto it = _devices.begin(); it != _devices.end(); it++)
+            {
+                if (!it->second.cuDetected ||
+                    it->second.subscriptionType != DeviceSubscriptionTypeEnum::None)
+                    continue;
+                it->second.subscriptionType = DeviceSubscriptionTypeEnum::Cuda;
+            }
+        }
+#endif
+#if ETC_KECCAKCL
+        if (!m_CLSettings.devices.size() &&
+            (m_minerType == MinerType::CL || m_minerType == MinerType::Mixed))
+        {
+            for (auto it = _devices.begin(); it != _devices.end(); it++)
+            {
+                if (!it->second.clDetected ||
+                    it->second.subscriptionType != DeviceSubscriptionTypeEnum::None)
+                    continue;
+                it->second.subscriptionType = DeviceSubscriptionTypeEnum::OpenCL;
+            }
+        }
+#endif
+#if ETC_KECCAKCPU
+        if (!m_CPSettings.devices.size() &&
+            (m_minerType == MinerType::CPU))
+        {
+            for (auto it = _devices.begin(); it != _devices.end(); it++)
+            {
+                it->second.subscriptionType = DeviceSubscriptionTypeEnum::Cpu;
+            }
+        }
+#endif
+    }
+
+    void execute()
+    {
+        enumDevices(m_DevicesCollection);
 
         // Can't proceed without any GPU
         if (!m_DevicesCollection.size())
@@ -635,100 +797,8 @@ public:
             return;
         }
 
-        // Subscribe devices with appropriate Miner Type
-        // Use CUDA first when available then, as second, OpenCL
+        subscribeDevices(m_DevicesCollection);
 
-        // Apply discrete subscriptions (if any)
-#if ETC_KECCAKCUDA
-        if (m_CUSettings.devices.size() &&
-            (m_minerType == MinerType::CUDA || m_minerType == MinerType::Mixed))
-        {
-            for (auto index : m_CUSettings.devices)
-            {
-                if (index < m_DevicesCollection.size())
-                {
-                    auto it = m_DevicesCollection.begin();
-                    std::advance(it, index);
-                    if (!it->second.cuDetected)
-                        throw std::runtime_error("Can't CUDA subscribe a non-CUDA device.");
-                    it->second.subscriptionType = DeviceSubscriptionTypeEnum::Cuda;
-                }
-            }
-        }
-#endif
-#if ETC_KECCAKCL
-        if (m_CLSettings.devices.size() &&
-            (m_minerType == MinerType::CL || m_minerType == MinerType::Mixed))
-        {
-            for (auto index : m_CLSettings.devices)
-            {
-                if (index < m_DevicesCollection.size())
-                {
-                    auto it = m_DevicesCollection.begin();
-                    std::advance(it, index);
-                    if (!it->second.clDetected)
-                        throw std::runtime_error("Can't OpenCL subscribe a non-OpenCL device.");
-                    if (it->second.subscriptionType != DeviceSubscriptionTypeEnum::None)
-                        throw std::runtime_error(
-                            "Can't OpenCL subscribe a CUDA subscribed device.");
-                    it->second.subscriptionType = DeviceSubscriptionTypeEnum::OpenCL;
-                }
-            }
-        }
-#endif
-#if ETC_KECCAKCPU
-        if (m_CPSettings.devices.size() && (m_minerType == MinerType::CPU))
-        {
-            for (auto index : m_CPSettings.devices)
-            {
-                if (index < m_DevicesCollection.size())
-                {
-                    auto it = m_DevicesCollection.begin();
-                    std::advance(it, index);
-                    it->second.subscriptionType = DeviceSubscriptionTypeEnum::Cpu;
-                }
-            }
-        }
-#endif
-
-
-        // Subscribe all detected devices
-#if ETC_KECCAKCUDA
-        if (!m_CUSettings.devices.size() &&
-            (m_minerType == MinerType::CUDA || m_minerType == MinerType::Mixed))
-        {
-            for (auto it = m_DevicesCollection.begin(); it != m_DevicesCollection.end(); it++)
-            {
-                if (!it->second.cuDetected ||
-                    it->second.subscriptionType != DeviceSubscriptionTypeEnum::None)
-                    continue;
-                it->second.subscriptionType = DeviceSubscriptionTypeEnum::Cuda;
-            }
-        }
-#endif
-#if ETC_KECCAKCL
-        if (!m_CLSettings.devices.size() &&
-            (m_minerType == MinerType::CL || m_minerType == MinerType::Mixed))
-        {
-            for (auto it = m_DevicesCollection.begin(); it != m_DevicesCollection.end(); it++)
-            {
-                if (!it->second.clDetected ||
-                    it->second.subscriptionType != DeviceSubscriptionTypeEnum::None)
-                    continue;
-                it->second.subscriptionType = DeviceSubscriptionTypeEnum::OpenCL;
-            }
-        }
-#endif
-#if ETC_KECCAKCPU
-        if (!m_CPSettings.devices.size() &&
-            (m_minerType == MinerType::CPU))
-        {
-            for (auto it = m_DevicesCollection.begin(); it != m_DevicesCollection.end(); it++)
-            {
-                it->second.subscriptionType = DeviceSubscriptionTypeEnum::Cpu;
-            }
-        }
-#endif
         // Count of subscribed devices
         int subscribedDevices = 0;
         for (auto it = m_DevicesCollection.begin(); it != m_DevicesCollection.end(); it++)
@@ -750,10 +820,20 @@ public:
 #endif
         signal(SIGINT, MinerCLI::signalHandler);
         signal(SIGTERM, MinerCLI::signalHandler);
+#if defined(__linux__) || defined(__APPLE__)
+        signal(SIGHUP, MinerCLI::signalHandler);
+#endif
 
         // Initialize Farm
         new Farm(m_DevicesCollection, m_FarmSettings, m_CUSettings, m_CLSettings, m_CPSettings);
 
+        // Devices may come and go while mining. Discrete subscriptions
+        // refer to the order of the new enumeration
+        Farm::f().onDevicesRescan([this](std::map<string, DeviceDescriptor>& _devices) {
+            enumDevices(_devices);
+            subscribeDevices(_devices);
+        });
+
         // Run Miner
         doMiner();
     }
@@ -775,7 +855,7 @@ public:
              << "    -U,--cuda           Mine/Benchmark using CUDA only" << endl
 #endif
 #if ETC_KECCAKCPU
-             << "    --cpu               Development ONLY ! (NO MINING)" << endl
+             << "    --cpu               Mine/Benchmark using CPU only" << endl
 #endif
              << endl
              << "Connection options :" << endl
@@ -965,6 +1045,66 @@ public:
                  << "                        Space separated list of device indexes to use" << endl
                  << "                        eg --cp-devices 0 2 3" << endl
                  << "                        If not set all available CPUs will be used" << endl
+                 << "    --cp-policy         TEXT {logical,core,numa,list} Default = logical" << endl
+                 << "                        How miner threads are placed on CPUs this process"
+                 << endl
+                 << "                        is allowed to use (taskset, cgroup cpusets) and"
+                 << endl
+                 << "                        which are not isolated" << endl
+                 << "                        'logical' One thread pinned to each logical CPU" << endl
+                 << "                        'core'    One thread pinned to each physical core"
+                 << endl
+                 << "                                  leaving SMT siblings idle" << endl
+                 << "                        'numa'    One thread per logical CPU free to move"
+                 << endl
+                 << "                                  within its NUMA node" << endl
+                 << "                        'list'    One thread pinned to each CPU of --cp-cpus"
+                 << endl
+                 << "    --cp-cpus           UINT {} Default not set" << endl
+                 << "                        Space separated list of logical CPU ids (isolated"
+                 << endl
+                 << "                        ones included). Implies --cp-policy list" << endl
+                 << "                        eg --cp-cpus 2 3 6 7" << endl
+                 << "    --cp-pool           FLAG" << endl
+                 << "                        Expose a single CPU device backed by one thread" << endl
+                 << "                        per placement of --cp-policy. Threads share the"
+                 << endl
+                 << "                        device nonce segment and steal work from slower"
+                 << endl
+                 << "                        ones. Hashrate is reported for the whole pool" << endl
+                 << "    --cp-latency        UINT[50 .. 100000] Default = 500" << endl
+                 << "                        Target time in microseconds to notice a new job."
+                 << endl
+                 << "                        Nonces hashed between checks adapt to it: lower"
+                 << endl
+                 << "                        means less stale shares, higher less overhead" << endl
+                 << "    --cp-idle           FLAG" << endl
+                 << "                        Run hash threads under SCHED_IDLE so any other task"
+                 << endl
+                 << "                        on the host preempts them (idle priority on Windows)"
+                 << endl
+                 << "    --cp-nice           INT[-20 .. 19] Default = 0" << endl
+                 << "                        Nice level of hash threads" << endl
+                 << "    --cp-share          UINT[1 .. 100] Default = 100" << endl
+                 << "                        Percent of CPU time each hash thread may use. Threads"
+                 << endl
+                 << "                        sleep between batches to stay within this share" << endl
+                 << "    --cp-pressure       UINT[0 .. 100] Default = 0" << endl
+                 << "                        When not 0 CPU share is halved every second the host"
+                 << endl
+                 << "                        is contended then recovers gradually. Contended means"
+                 << endl
+                 << "                        /proc/pressure/cpu 'some avg10' above this percentage"
+                 << endl
+                 << "                        or, without PSI, more runnable tasks than CPUs" << endl
+                 << "    --cp-counters       FLAG" << endl
+                 << "                        Sample hardware counters of hash threads (Linux"
+                 << endl
+                 << "                        perf_event_open) and report cycles per hash, IPC,"
+                 << endl
+                 << "                        clock and stalled cycles next to hashrate and in"
+                 << endl
+                 << "                        miner_getstatdetail API" << endl
                  << endl;
         }
 
@@ -1030,6 +1170,26 @@ public:
                  << "                        found nonces. Trims some ms. from submission" << endl
                  << "                        time but it may increase rejected solution rate."
                  << endl
+                 << "    --nonce-ledger      TEXT Default not set" << endl
+                 << "                        Persist the ranges of nonces scanned on current job"
+                 << endl
+                 << "                        to this file. When keccakminer restarts on the same"
+                 << endl
+                 << "                        job (eg solo mining over getwork) it resumes where"
+                 << endl
+                 << "                        it stopped instead of scanning those nonces again."
+                 << endl
+                 << "                        Written at most once a minute and on exit" << endl
+                 << "    --history           TEXT Default 1:3600,60:86400" << endl
+                 << "                        Telemetry kept in memory for the API, as a comma"
+                 << endl
+                 << "                        separated list of resolution:retention in seconds."
+                 << endl
+                 << "                        Each resolution must be a multiple of the previous"
+                 << endl
+                 << "                        one. Default keeps 1 hour by second and 24 hours by"
+                 << endl
+                 << "                        minute. Set to off to disable" << endl
                  << "    --list-devices      FLAG Lists the detected OpenCL/CUDA devices and "
                     "exits"
                  << endl
@@ -1236,7 +1396,14 @@ private:
         // Stay in non-busy wait till signals arrive
         unique_lock<mutex> clilock(m_climtx);
         while (g_running)
+        {
             g_shouldstop.wait(clilock);
+            if (g_rescan.exchange(false))
+            {
+                cnote << "Rescanning devices ...";
+                Farm::f().rescanDevices_async();
+            }
+        }
 
 #if API_CORE
 
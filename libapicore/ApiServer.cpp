@@ -186,6 +186,20 @@ static bool checkApiWriteAccess(bool is_read_only, Json::Value& jResponse)
     return !is_read_only;
 }
 
+static Json::Value getRates(HashRateType const& rates)
+{
+    // 10 seconds, 1 minute and 15 minutes averages in hashes per second
+    Json::Value jrates;
+    jrates["ewma"] = Json::Value(Json::arrayValue);
+    jrates["window"] = Json::Value(Json::arrayValue);
+    for (unsigned i = 0; i < 3; i++)
+    {
+        jrates["ewma"].append(uint64_t(rates.ewma[i]));
+        jrates["window"].append(uint64_t(rates.window[i]));
+    }
+    return jrates;
+}
+
 static bool parseRequestId(Json::Value& jRequest, Json::Value& jResponse)
 {
     const char* membername = "id";
@@ -457,6 +471,28 @@ void ApiConnection::processRequest(Json::Value& jRequest, Json::Value& jResponse
         jResponse["result"] = getMinerStatDetail();
     }
 
+    else if (_method == "miner_gethistory")
+    {
+        // All parameters are optional
+        Json::Value jRequestParams;
+        if (!getRequestValue("params", jRequestParams, jRequest, true, jResponse))
+            return;
+
+        uint64_t to = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        uint64_t from = to > 3600 ? to - 3600 : 0;
+        unsigned resolution = 0;
+        unsigned count = 3600;
+        if (!getRequestValue("from", from, jRequestParams, true, jResponse) ||
+            !getRequestValue("to", to, jRequestParams, true, jResponse) ||
+            !getRequestValue("resolution", resolution, jRequestParams, true, jResponse) ||
+            !getRequestValue("count", count, jRequestParams, true, jResponse))
+            return;
+
+        if (!count || count > 3600)
+            count = 3600;  // Not above
+        jResponse["result"] = getMinerHistory(from, to, resolution, count);
+    }
+
     else if (_method == "miner_shuffle")
     {
         if (!checkApiWriteAccess(m_readonly, jResponse))
@@ -713,6 +749,39 @@ void ApiConnection::processRequest(Json::Value& jRequest, Json::Value& jResponse
         }
     }
 
+    else if (_method == "miner_restartgpu")
+    {
+        if (!checkApiWriteAccess(m_readonly, jResponse))
+            return;
+
+        Json::Value jRequestParams;
+        if (!getRequestValue("params", jRequestParams, jRequest, false, jResponse))
+            return;
+
+        unsigned index;
+        if (!getRequestValue("index", index, jRequestParams, false, jResponse))
+            return;
+
+        if (!Farm::f().getMiner(index))
+        {
+            jResponse["error"]["code"] = -422;
+            jResponse["error"]["message"] = "Index out of bounds";
+            return;
+        }
+
+        // Restarts asynchronously as waiting for the device may take a while
+        jResponse["result"] = true;
+        Farm::f().restartMiner_async(index);
+    }
+
+    else if (_method == "miner_rescandevices")
+    {
+        if (!checkApiWriteAccess(m_readonly, jResponse))
+            return;
+        jResponse["result"] = true;
+        Farm::f().rescanDevices_async();
+    }
+
     else if (_method == "miner_setverbosity")
     {
         if (!checkApiWriteAccess(m_readonly, jResponse))
@@ -1070,14 +1139,27 @@ Json::Value ApiConnection::getMinerStatDetailPerMiner(
     mininginfo["pause_reason"] = _miner->paused() ? _miner->pausedString() : Json::Value::null;
 
     /* Nonce infos */
-    auto segment_width = Farm::f().get_segment_width();
-    uint64_t gpustartnonce = Farm::f().get_nonce_scrambler() + ((uint64_t)_index << segment_width);
-    jsegment.append(toHex(uint64_t(gpustartnonce), HexPrefix::Add));
-    jsegment.append(toHex(uint64_t(gpustartnonce + (1LL << segment_width)), HexPrefix::Add));
+    NonceRange segment = Farm::f().get_nonce_range(_index);
+    jsegment.append(toHex(segment.start, HexPrefix::Add));
+    jsegment.append(toHex(segment.end, HexPrefix::Add));
     mininginfo["segment"] = jsegment;
 
     /* Hash & Share infos */
     mininginfo["hashrate"] = toHex((uint32_t)_t.miners.at(_index).hashrate, HexPrefix::Add);
+    mininginfo["rates"] = getRates(_t.miners.at(_index).rates);
+
+    /* Hardware counters */
+    HwCountersType const& counters = _t.miners.at(_index).counters;
+    if (counters.valid)
+    {
+        Json::Value jcounters;
+        jcounters["cycles_per_hash"] = counters.cyclesPerHash;
+        jcounters["ipc"] = counters.ipc;
+        jcounters["mhz"] = counters.mhz;
+        jcounters["stalled"] = counters.stalled >= 0.0 ? Json::Value(counters.stalled) :
+                                                         Json::Value::null;
+        mininginfo["counters"] = jcounters;
+    }
 
     jRes["hardware"] = hwinfo;
     jRes["mining"] = mininginfo;
@@ -1194,6 +1276,58 @@ std::string ApiConnection::getHttpMinerStatDetail()
     return _ret.str();
 }
 
+/**
+ * @brief Return periods of miners' history, one array per field and miner.
+ * Period i starts at start + i * resolution. A period with no record is null
+ */
+Json::Value ApiConnection::getMinerHistory(
+    uint64_t _from, uint64_t _to, unsigned _resolution, unsigned _count)
+{
+    TelemetrySeries series = Farm::f().History().query(_from, _to, _resolution, _count);
+
+    size_t miners = 0;
+    for (auto const& period : series.periods)
+        miners = std::max(miners, period.size());
+
+    Json::Value jminers = Json::Value(Json::arrayValue);
+    for (size_t i = 0; i < miners; i++)
+    {
+        Json::Value jminer;
+        const char* fields[] = {"hashrate", "accepted", "rejected", "failed", "tempC", "fanP",
+            "powerW", "switch_ms"};
+        for (const char* field : fields)
+            jminer[field] = Json::Value(Json::arrayValue);
+
+        for (auto const& period : series.periods)
+        {
+            if (i >= period.size())
+            {
+                for (const char* field : fields)
+                    jminer[field].append(Json::Value::null);
+                continue;
+            }
+            TelemetrySample const& s = period[i];
+            jminer["hashrate"].append(uint64_t(s.hashrate));
+            jminer["accepted"].append(s.accepted);
+            jminer["rejected"].append(s.rejected);
+            jminer["failed"].append(s.failed);
+            jminer["tempC"].append(s.tempC);
+            jminer["fanP"].append(s.fanP);
+            jminer["powerW"].append(s.powerW);
+            jminer["switch_ms"].append(s.switchMs);
+        }
+        jminer["_index"] = unsigned(i);
+        jminers.append(jminer);
+    }
+
+    Json::Value jRes;
+    jRes["resolution"] = series.resolution;
+    jRes["start"] = series.start;
+    jRes["end"] = series.start + uint64_t(series.periods.size()) * series.resolution;
+    jRes["miners"] = jminers;
+    return jRes;
+}
+
 /**
  * @brief Return a total and per GPU detailed list of current status
  * As we return here difficulty and share counts (which are not getting resetted if we
@@ -1242,6 +1376,7 @@ Json::Value ApiConnection::getMinerStatDetail()
     Json::Value sharesinfo = Json::Value(Json::arrayValue);
 
     mininginfo["hashrate"] = toHex(uint32_t(t.farm.hashrate), HexPrefix::Add);
+    mininginfo["rates"] = getRates(t.farm.rates);
     mininginfo["epoch"] = PoolManager::p().getCurrentEpoch();
     mininginfo["epoch_changes"] = PoolManager::p().getEpochChanges();
     mininginfo["difficulty"] = PoolManager::p().getCurrentDifficulty();
@@ -49,6 +49,7 @@ private:
 
     Json::Value getMinerStatDetail();
     Json::Value getMinerStatDetailPerMiner(const TelemetryType& _t, std::shared_ptr<Miner> _miner);
+    Json::Value getMinerHistory(uint64_t _from, uint64_t _to, unsigned _resolution, unsigned _count);
 
     std::string getHttpMinerStatDetail();
 
@@ -209,6 +209,17 @@ void addDefinition(string& _source, char const* _id, unsigned _value)
     _source.insert(_source.begin(), buf, buf + strlen(buf));
 }
 
+// Lane layout of a single block message format
+template <typename Format>
+void addFormatDefinitions(string& _source)
+{
+    addDefinition(_source, "HEADER_LANES", Format::headerBytes / 8);
+    addDefinition(_source, "NONCE_LANE", Format::nonceLane);
+    addDefinition(_source, "PAD_LANE", Format::messageBytes / 8);
+    addDefinition(_source, "PAD_BYTE", Format::pad);
+    addDefinition(_source, "RATE_LANES", Format::rateLanes);
+}
+
 std::vector<cl::Platform> getPlatforms()
 {
     vector<cl::Platform> platforms;
@@ -295,6 +306,7 @@ void CLMiner::workLoop()
     // The work package currently processed by GPU.
     WorkPackage current;
     current.header = h256();
+    std::shared_ptr<const WorkPackage> currentJob;  // Shared by solutions found on current
 
     if (!initDevice())
     return;
@@ -341,14 +353,11 @@ void CLMiner::workLoop()
             else
                 results.count = 0;
 
-            // Wait for work or 3 seconds (whichever the first)
-            const WorkPackage w = work();
+            // Wait for work, resume or 3 seconds (whichever the first)
+            WorkPackage const& w = work();
             if (!w)
             {
-                boost::system_time const timeout =
-                    boost::get_system_time() + boost::posix_time::seconds(3);
-                boost::mutex::scoped_lock l(x_work);
-                m_new_work_signal.timed_wait(l, timeout);
+                waitForWork();
                 continue;
             }
 
@@ -363,7 +372,7 @@ void CLMiner::workLoop()
                 
                 // Update header constant buffer.
                 m_queue[0].enqueueWriteBuffer(
-                    m_header[0], CL_FALSE, 0, w.header.size, w.header.data());
+                    m_header[0], CL_FALSE, 0, CLSearchFormat::headerBytes, w.header.data());
                 // zero the result count
                 m_queue[0].enqueueWriteBuffer(m_searchBuffer[0], CL_FALSE,
                     offsetof(SearchResults, count),
@@ -394,6 +403,7 @@ void CLMiner::workLoop()
                 // Report results while the kernel is running.
                 for (uint32_t i = 0; i < results.count; i++)
                 {
+                    // Nonce lane as the kernel hashed it, little-endian
                     uint64_t nonce = (current.startNonce << 32) | results.rslt[i].gid;
                     if (nonce != m_lastNonce)
                     {
@@ -401,8 +411,9 @@ void CLMiner::workLoop()
                         h256 mix;
                         memcpy(mix.data(), (char*)results.rslt[i].mix, sizeof(results.rslt[i].mix));
 
-                        Farm::f().submitProof(Solution{
-                            be64toh(nonce), mix, current, std::chrono::steady_clock::now(), m_index});
+                        uint64_t solNonce = CLSearchFormat::nonceBigEndian ? be64toh(nonce) : nonce;
+                        Farm::f().submitProof(Solution{solNonce, mix, currentJob,
+                            std::chrono::steady_clock::now(), m_index});
                         cllog << EthWhite << "Job: " << current.header.abridged() << " Sol: 0x"
                               << toHex(nonce) << EthReset;
                     }
@@ -410,6 +421,7 @@ void CLMiner::workLoop()
             }
 
             current = w;  // kernel now processing newest work
+            currentJob = workJob();
             current.startNonce = startNonce;
             // Increase start nonce for following kernel execution.
             startNonce += 1;
@@ -441,6 +453,10 @@ void CLMiner::kick_miner()
         m_abortqueue[0].enqueueWriteBuffer(
             m_searchBuffer[0], CL_TRUE, offsetof(SearchResults, abort), sizeof(one), &one);
 
+    {
+        // Under the lock waitForWork() sleeps with, so the wakeup can't be missed
+        boost::mutex::scoped_lock l(x_work);
+    }
     m_new_work_signal.notify_one();
 }
 
@@ -724,6 +740,7 @@ bool CLMiner::initEpoch_internal()
         addDefinition(code, "MAX_OUTPUTS", c_maxSearchResults);
         addDefinition(code, "PLATFORM", static_cast<unsigned>(m_deviceDescriptor.clPlatformType));
         addDefinition(code, "COMPUTE", computeCapability);
+        addFormatDefinitions<CLSearchFormat>(code);
 
         if (m_deviceDescriptor.clPlatformType == ClPlatformTypeEnum::Clover)
             addDefinition(code, "LEGACY", 1);
@@ -754,7 +771,8 @@ bool CLMiner::initEpoch_internal()
         // create buffer for header
         cllog << "Creating buffer for header.";
         m_header.clear();
-        m_header.push_back(cl::Buffer(m_context[0], CL_MEM_READ_ONLY, 32));
+        m_header.push_back(
+            cl::Buffer(m_context[0], CL_MEM_READ_ONLY, CLSearchFormat::headerBytes));
 
         m_searchKernel.setArg(1, m_header[0]);
 
@@ -9,6 +9,7 @@
 
 #include <libdevcore/Worker.h>
 #include <libkeccakcore/KeccakAux.h>
+#include <libkeccakcore/KeccakFormat.h>
 #include <libkeccakcore/Miner.h>
 
 #include <boost/algorithm/string/predicate.hpp>
@@ -40,6 +41,16 @@ namespace dev
 {
 namespace etc
 {
+/**
+ * @brief Message format the OpenCL search kernel is built for. Its layout
+ * reaches keccak.cl as defines, so each format compiles its own kernel
+ */
+typedef Keccak256Format CLSearchFormat;
+static_assert(CLSearchFormat::blocks == 1 && CLSearchFormat::headerBytes % 8 == 0 &&
+                  CLSearchFormat::nonceOffset % 8 == 0,
+    "OpenCL search kernel hashes a single block with lane aligned header and nonce");
+static_assert(CLSearchFormat::headerBytes <= sizeof(h256), "Work packages carry a 32 bytes header");
+
 class CLMiner : public Miner
 {
 public:
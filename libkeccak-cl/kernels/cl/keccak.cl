@@ -222,32 +222,19 @@ __kernel void search(
 
     const uint gid = get_global_id(0);
 
+    // Message layout comes from CLSearchFormat (see CLMiner.cpp):
+    // header lanes with the nonce lane inserted at NONCE_LANE, padding
+    // byte at PAD_LANE and final bit at the end of the rate
     uint2 state[25];
-    state[0] = g_header[0];
-    state[1] = g_header[1];
-    state[2] = g_header[2];
-    state[3] = g_header[3];
-    state[4] = (uint2)(gid,start_nonce);
-    state[5] = as_uint2(0x0000000000000001UL);
-    state[6] = (uint2)(0);
-    state[7] = (uint2)(0);
-    state[8] = (uint2)(0);
-    state[9] = (uint2)(0);
-    state[10] = (uint2)(0);
-    state[11] = (uint2)(0);
-    state[12] = (uint2)(0);
-    state[13] = (uint2)(0);
-    state[14] = (uint2)(0);
-    state[15] = (uint2)(0);
-    state[16] = as_uint2(0x8000000000000000UL);
-    state[17] = (uint2)(0);
-    state[18] = (uint2)(0);
-    state[19] = (uint2)(0);
-    state[20] = (uint2)(0);
-    state[21] = (uint2)(0);
-    state[22] = (uint2)(0);
-    state[23] = (uint2)(0);
-    state[24] = (uint2)(0);
+#pragma unroll
+    for (uint i = 0; i < 25; ++i)
+        state[i] = (uint2)(0);
+#pragma unroll
+    for (uint i = 0; i < HEADER_LANES; ++i)
+        state[i < NONCE_LANE ? i : i + 1] = g_header[i];
+    state[NONCE_LANE] = (uint2)(gid, start_nonce);
+    state[PAD_LANE].s0 ^= PAD_BYTE;
+    state[RATE_LANES - 1].s1 ^= 0x80000000u;
 
 #pragma unroll
     for (int r = 0; r < 24; ++r) { 
@@ -0,0 +1,101 @@
+/*
+This file is part of keccakminer.
+
+keccakminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+keccakminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+#include "CPUCounters.h"
+
+using namespace dev;
+using namespace etc;
+
+namespace
+{
+#if defined(__linux__)
+// Counter of the calling thread on whichever CPU it runs, user space only
+int openCounter(uint32_t _type, uint64_t _config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = _type;
+    attr.config = _config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+uint64_t readCounter(int _fd)
+{
+    if (_fd < 0)
+        return 0;
+    uint64_t values[3];  // value, time enabled, time running
+    if (::read(_fd, values, sizeof(values)) != (ssize_t)sizeof(values) || !values[2])
+        return 0;
+    if (values[2] == values[1])
+        return values[0];
+    return (uint64_t)((double)values[0] * values[1] / values[2]);
+}
+#endif
+
+}  // namespace
+
+PerfCounters::~PerfCounters()
+{
+#if defined(__linux__)
+    for (int fd : m_fds)
+        if (fd >= 0)
+            close(fd);
+#endif
+}
+
+bool PerfCounters::open()
+{
+#if defined(__linux__)
+    m_fds[Cycles] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    m_fds[Instructions] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    if (m_fds[Cycles] < 0 || m_fds[Instructions] < 0)
+        return false;
+
+    // Many PMUs (most recent Intel ones) have no generic stall events.
+    // Frontend and backend stalls overlap thus can't be summed : backend
+    // ones tell how busy execution ports are, which is what hashing hits
+    m_fds[Stalled] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND);
+    m_fds[TaskClock] = openCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+    return true;
+#else
+    return false;
+#endif
+}
+
+PerfSample PerfCounters::read() const
+{
+    PerfSample sample;
+#if defined(__linux__)
+    sample.cycles = readCounter(m_fds[Cycles]);
+    sample.instructions = readCounter(m_fds[Instructions]);
+    sample.stalled = readCounter(m_fds[Stalled]);
+    sample.taskClock = readCounter(m_fds[TaskClock]);
+#endif
+    return sample;
+}
@@ -0,0 +1,88 @@
+/*
+This file is part of keccakminer.
+
+keccakminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+keccakminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace dev
+{
+namespace etc
+{
+/**
+ * @brief Raw counts of a thread since its counters were opened
+ */
+struct PerfSample
+{
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t stalled = 0;    // Backend stalled cycles
+    uint64_t taskClock = 0;  // Nanoseconds the thread was on a CPU
+
+    PerfSample& operator+=(PerfSample const& _s)
+    {
+        cycles += _s.cycles;
+        instructions += _s.instructions;
+        stalled += _s.stalled;
+        taskClock += _s.taskClock;
+        return *this;
+    }
+};
+
+/**
+ * @brief perf_event_open() counters of the thread which opened them.
+ * They can be read from any thread. Linux only : elsewhere open() fails
+ */
+class PerfCounters
+{
+public:
+    PerfCounters() = default;
+    PerfCounters(PerfCounters const&) = delete;
+    PerfCounters& operator=(PerfCounters const&) = delete;
+    ~PerfCounters();
+
+    /**
+     * @brief Opens counters for the calling thread
+     * @return false if cycles or instructions can't be counted
+     * (no PMU, perf_event_paranoid, seccomp ...)
+     */
+    bool open();
+
+    /**
+     * @brief Whether or not stalled cycles are counted on this host
+     */
+    bool hasStalled() const { return m_fds[Stalled] >= 0; }
+
+    /**
+     * @brief Counts since open, scaled when the PMU was multiplexed
+     */
+    PerfSample read() const;
+
+private:
+    enum
+    {
+        Cycles,
+        Instructions,
+        Stalled,
+        TaskClock,
+        Count
+    };
+    int m_fds[Count] = {-1, -1, -1, -1};
+};
+
+}  // namespace etc
+}  // namespace dev
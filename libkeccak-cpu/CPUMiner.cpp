@@ -16,8 +16,8 @@ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 /*
- CPUMiner simulates mining devices but does NOT real mine!
- USE FOR DEVELOPMENT ONLY !
+ CPUMiner hashes Keccak-256 natively on host CPUs (see KeccakSearch.cpp).
+ No epoch context nor DAG is needed.
 */
 
 #if defined(__linux__)
@@ -30,16 +30,11 @@ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
 #endif
 
 #include <libkeccakcore/Farm.h>
-#include <ethash/ethash.hpp>
 
 #include <boost/version.hpp>
 
-#if 0
-#include <boost/fiber/numa/pin_thread.hpp>
-#include <boost/fiber/numa/topology.hpp>
-#endif
-
 #include "CPUMiner.h"
+#include "CPUTopology.h"
 
 
 /* Sanity check for defined OS */
@@ -118,46 +113,11 @@ static size_t getTotalPhysAvailableMemory()
 }
 
 /*
- * return numbers of available CPUs
+ * return numbers of logical CPUs this process may use
  */
 unsigned CPUMiner::getNumDevices()
 {
-#if 0
-    static unsigned cpus = 0;
-
-    if (cpus == 0)
-    {
-        std::vector< boost::fibers::numa::node > topo = boost::fibers::numa::topology();
-        for (auto n : topo) {
-            cpus += n.logical_cpus.size();
-        }
-    }
-    return cpus;
-#elif defined(__APPLE__) || defined(__MACOSX)
-    unsigned int cpus_available = std::thread::hardware_concurrency();
-    if (cpus_available <= 0)
-    {
-        cwarn << "Error in func " << __FUNCTION__ << " at std::thread::hardware_concurrency \""
-              << cpus_available << " were found." << "\"\n";
-        return 0;
-    }
-    return cpus_available;
-
-#elif defined(__linux__)
-    long cpus_available;
-    cpus_available = sysconf(_SC_NPROCESSORS_ONLN);
-    if (cpus_available == -1L)
-    {
-        cwarn << "Error in func " << __FUNCTION__ << " at sysconf(_SC_NPROCESSORS_ONLN) \""
-              << strerror(errno) << "\"\n";
-        return 0;
-    }
-    return cpus_available;
-#else
-    SYSTEM_INFO sysinfo;
-    GetSystemInfo(&sysinfo);
-    return sysinfo.dwNumberOfProcessors;
-#endif
+    return cpuTopology().size();
 }
 
 
@@ -170,9 +130,23 @@ struct CPUChannel : public LogChannel
 };
 #define cpulog clog(CPUChannel)
 
+namespace
+{
+constexpr unsigned c_maxFound = 4;          // Nonces a kernel call may report
+constexpr unsigned c_batchStep = 32;        // Multiple of every kernel's lanes
+constexpr unsigned c_batchMax = 1u << 22;   // Keeps hash counts within 32 bits
+
+unsigned clampBatch(uint64_t _batch)
+{
+    _batch = _batch / c_batchStep * c_batchStep;
+    return (unsigned)std::min(std::max(_batch, (uint64_t)c_batchStep), (uint64_t)c_batchMax);
+}
+
+}  // namespace
+
 
 CPUMiner::CPUMiner(unsigned _index, CPSettings _settings, DeviceDescriptor& _device)
-  : Miner("cpu-", _index), m_settings(_settings)
+  : Miner("cpu-", _index), m_settings(_settings), m_throttle(_settings)
 {
     m_deviceDescriptor = _device;
 }
@@ -188,43 +162,99 @@ CPUMiner::~CPUMiner()
 
 
 /*
- * Bind the current thread to a spcific CPU
+ * Bind the current thread to the given CPUs
  */
-bool CPUMiner::initDevice()
+void CPUMiner::bindThread(std::vector<unsigned> const& _cpus)
 {
-    DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::initDevice begin");
-
-    cpulog << "Using CPU: " << m_deviceDescriptor.cpCpuNumer << " " << m_deviceDescriptor.cuName
-           << " Memory : " << dev::getFormattedMemory((double)m_deviceDescriptor.totalMemory);
-
 #if defined(__APPLE__) || defined(__MACOSX)
 /* Not supported on MAC OSX. See https://developer.apple.com/library/archive/releasenotes/Performance/RN-AffinityAPI/ */
+    (void)_cpus;
 #elif defined(__linux__)
     cpu_set_t cpuset;
     int err;
 
     CPU_ZERO(&cpuset);
-    CPU_SET(m_deviceDescriptor.cpCpuNumer, &cpuset);
+    for (auto cpu : _cpus)
+        CPU_SET(cpu, &cpuset);
 
     err = sched_setaffinity(0, sizeof(cpuset), &cpuset);
     if (err != 0)
     {
         cwarn << "Error in func " << __FUNCTION__ << " at sched_setaffinity() \"" << strerror(errno)
               << "\"\n";
-        cwarn << "cp-" << m_index << "could not bind thread to cpu" << m_deviceDescriptor.cpCpuNumer
-              << "\n";
+        cwarn << "cp-" << m_index << "could not bind thread to cpu" << _cpus.front() << "\n";
     }
 #else
-    DWORD_PTR dwThreadAffinityMask = 1i64 << m_deviceDescriptor.cpCpuNumer;
+    DWORD_PTR dwThreadAffinityMask = 0;
+    for (auto cpu : _cpus)
+        dwThreadAffinityMask |= 1i64 << cpu;
     DWORD_PTR previous_mask;
     previous_mask = SetThreadAffinityMask(GetCurrentThread(), dwThreadAffinityMask);
     if (previous_mask == NULL)
     {
-        cwarn << "cp-" << m_index << "could not bind thread to cpu" << m_deviceDescriptor.cpCpuNumer
-              << "\n";
+        cwarn << "cp-" << m_index << "could not bind thread to cpu" << _cpus.front() << "\n";
         // Handle Errorcode (GetLastError) ??
     }
 #endif
+}
+
+
+/*
+ * Bind the current thread to a spcific CPU
+ */
+bool CPUMiner::initDevice()
+{
+    DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::initDevice begin");
+
+    cpulog << "Using CPU: " << m_deviceDescriptor.cpCpuNumer << " (core "
+           << m_deviceDescriptor.cpCore << " node " << m_deviceDescriptor.cpNode << ") "
+           << m_deviceDescriptor.cuName
+           << " Memory : " << dev::getFormattedMemory((double)m_deviceDescriptor.totalMemory);
+
+    // Native search must give the very same digests as KeccakAux::eval
+    m_kernel = keccakSearchKernel();
+    if (!keccakSearchSelfTest(m_kernel))
+    {
+        cwarn << "cp-" << m_index << " Keccak " << m_kernel.name
+              << " kernel self test failed. CPU mining disabled.";
+        return false;
+    }
+    cpulog << "Using Keccak kernel " << m_kernel.name << " (" << m_kernel.lanes << " lanes, "
+           << dev::getFormattedHashes(m_kernel.hashRate) << " per thread)";
+
+    // Startup benchmark gives the first guess, search then adapts to actual timings
+    m_batch = clampBatch((uint64_t)(m_kernel.hashRate * m_settings.latency / 1.0e6));
+    cpulog << "Initial batch of " << m_batch << " nonces for a " << m_settings.latency
+           << " us latency target";
+
+    m_throttle.applyPriority();
+    if (m_settings.counters)
+        openCounters();
+    if (m_settings.idle || m_settings.nice || m_settings.share < 100 || m_settings.pressure)
+        cpulog << "Co-tenant mode: " << (m_settings.idle ? "SCHED_IDLE" : "normal")
+               << " nice " << m_settings.nice << ", " << m_settings.share << "% CPU share"
+               << (m_settings.pressure ? ", backing off on contention" : "");
+
+    if (m_settings.pool)
+    {
+        // Worker thread is pool thread 0
+        m_placements = cpuPlacements(m_settings);
+        if (m_placements.empty())
+        {
+            cwarn << "cp-" << m_index << " No CPU left for the pool. CPU mining disabled.";
+            return false;
+        }
+        bindThread(m_placements.front().affinity);
+        startPool();
+        cpulog << "Using a pool of " << m_placements.size() << " threads";
+    }
+    else
+    {
+        vector<unsigned> cpus = m_deviceDescriptor.cpAffinity;
+        cpus.push_back(m_deviceDescriptor.cpCpuNumer);
+        bindThread(cpus);
+    }
+
     DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::initDevice end");
     return true;
 }
@@ -252,24 +282,168 @@ bool CPUMiner::initEpoch_internal()
 */
 void CPUMiner::kick_miner()
 {
-    m_new_work.store(true, std::memory_order_relaxed);
+    {
+        // Under the lock waiters sleep with, so the wakeup can't be missed
+        boost::mutex::scoped_lock l(x_work);
+        m_new_work.store(true, std::memory_order_relaxed);
+    }
     m_new_work_signal.notify_one();
+
+    // Pool threads drop current job after their chunk
+    {
+        boost::mutex::scoped_lock l(x_pool);
+        m_poolJob.reset();
+        m_poolGen++;
+    }
+    m_poolSignal.notify_all();
+}
+
+
+
+/*
+ * Every nonce of current job is hashed or being hashed : idle till kicked
+ * rather than hashing nonces of another miner's range
+ */
+void CPUMiner::waitForKick()
+{
+    boost::mutex::scoped_lock l(x_work);
+    if (!m_new_work.load(std::memory_order_relaxed) && !shouldStop())
+        cpulog << "cp-" << m_index << " Nonce space of job exhausted. Waiting for next job";
+    while (!m_new_work.load(std::memory_order_relaxed) && !shouldStop())
+        m_new_work_signal.timed_wait(l, boost::get_system_time() + boost::posix_time::seconds(1));
+}
+
+
+/*
+ * Throttling rest : a kick cuts it short so new work is picked up
+ * within --cp-latency whatever the CPU share
+ */
+void CPUMiner::rest(std::chrono::steady_clock::duration _time)
+{
+    if (_time <= std::chrono::steady_clock::duration::zero())
+        return;
+    boost::system_time const until =
+        boost::get_system_time() +
+        boost::posix_time::microseconds(
+            std::chrono::duration_cast<std::chrono::microseconds>(_time).count());
+    boost::mutex::scoped_lock l(x_work);
+    while (!m_new_work.load(std::memory_order_relaxed) && !shouldStop())
+        if (!m_new_work_signal.timed_wait(l, until))
+            break;
+}
+
+
+void CPUMiner::submitFound(
+    std::shared_ptr<const WorkPackage> const& _w, uint64_t const* _found, unsigned _count)
+{
+    for (unsigned i = 0; i < _count; i++)
+    {
+        // Kernels only prefilter on part of the digest : never trust a
+        // candidate which is not confirmed by the reference hash. It runs
+        // all rounds over the unmodified message, sharing no midstate code
+        // with the kernels
+        Result r = KeccakAux::eval(_w->header, _found[i]);
+        if (r.value > _w->boundary)
+        {
+            cwarn << "cp-" << m_index << " Keccak " << m_kernel.name
+                  << " kernel returned invalid nonce " << toHex(_found[i], HexPrefix::Add);
+            continue;
+        }
+        auto sol = Solution{_found[i], r.value, _w, std::chrono::steady_clock::now(), m_index};
+
+        cpulog << EthWhite << "Job: " << _w->header.abridged()
+               << " Sol: " << toHex(sol.nonce, HexPrefix::Add) << EthReset;
+        Farm::f().submitProof(sol);
+    }
+}
+
+
+/*
+ * Opens hardware counters for the calling hash thread
+ */
+void CPUMiner::openCounters()
+{
+    std::unique_ptr<PerfCounters> counters(new PerfCounters());
+    if (!counters->open())
+    {
+        cwarn << "cp-" << m_index << " Hardware counters not available (perf_event_open failed : "
+              << strerror(errno) << ")";
+        return;
+    }
+    boost::mutex::scoped_lock l(x_counters);
+    m_counters.push_back(std::move(counters));
+}
+
+
+/*
+ * Counters of all hash threads since previous call
+ */
+HwCountersType CPUMiner::RetrieveCounters()
+{
+    HwCountersType result;
+    boost::mutex::scoped_lock l(x_counters);
+    if (m_counters.empty())
+        return result;
+
+    PerfSample sample;
+    bool stalled = false;
+    for (auto const& counters : m_counters)
+    {
+        sample += counters->read();
+        stalled = stalled || counters->hasStalled();
+    }
+    uint64_t hashes = RetrieveHashCount();
+
+    double cycles = double(sample.cycles - m_lastSample.cycles);
+    double instructions = double(sample.instructions - m_lastSample.instructions);
+    double stalls = double(sample.stalled - m_lastSample.stalled);
+    double taskClock = double(sample.taskClock - m_lastSample.taskClock);
+    double done = double(hashes - m_lastHashes);
+    m_lastSample = sample;
+    m_lastHashes = hashes;
+
+    result.valid = true;
+    result.cyclesPerHash = done ? cycles / done : 0.0;
+    result.ipc = cycles ? instructions / cycles : 0.0;
+    result.mhz = taskClock ? cycles * 1000.0 / taskClock : 0.0;
+    result.stalled = !stalled ? -1.0 : (cycles ? stalls / cycles : 0.0);
+    return result;
 }
 
 
-void CPUMiner::search(const dev::eth::WorkPackage& w)
+/*
+ * Steers batch size so that one kernel call, thus the delay to notice new
+ * work, lasts about the latency target. Growth is capped to twice per call
+ * to ride out a preempted or unusually fast measurement
+ */
+void CPUMiner::adaptBatch(std::chrono::steady_clock::duration _busy)
 {
-    constexpr size_t blocksize = 30;
+    using namespace std::chrono;
+    uint64_t us = duration_cast<microseconds>(_busy).count();
+    uint64_t batch = m_batch;
+    uint64_t ideal = us ? batch * m_settings.latency / us : batch * 2;
+    m_batch = clampBatch(std::min(std::max((batch + ideal) / 2, batch / 2), batch * 2));
+}
+
 
-    const auto& context = ethash::get_global_epoch_context_full(w.epoch);
-    const auto header = ethash::hash256_from_bytes(w.header.data());
-    const auto boundary = ethash::hash256_from_bytes(w.boundary.data());
+void CPUMiner::search(const WorkPackage& w)
+{
+    KeccakSearchJob job;
+    keccakSearchPrepare(job, w);
+    std::shared_ptr<const WorkPackage> shared = workJob();
+    std::shared_ptr<const WorkSnapshot> snapshot = workSnapshot();
+    NonceLedgerView ledger(*snapshot->ledger);
+    uint64_t found[c_maxFound];
+    NonceRange range = workRange();
     auto nonce = w.startNonce;
 
     while (true)
     {
-        if (m_new_work.load(std::memory_order_relaxed))  // new work arrived ?
+        // New work arrived ? Nonces scanned so far reach the ledger
+        // before the next job's view is taken
+        if (m_new_work.load(std::memory_order_relaxed))
         {
+            ledger.flush();
             m_new_work.store(false, std::memory_order_relaxed);
             break;
         }
@@ -277,94 +451,340 @@ void CPUMiner::search(const dev::eth::WorkPackage& w)
         if (shouldStop())
             break;
 
-
-        auto r = ethash::search(context, header, boundary, nonce, blocksize);
-        if (r.solution_found)
+        // Skip nonces scanned before a pause or a restart. Never
+        // run into another miner's range
+        NonceRange todo = ledger.uncovered(NonceRange{nonce, range.end});
+        if (!todo.size())
         {
-            h256 mix{reinterpret_cast<byte*>(r.mix_hash.bytes), h256::ConstructFromPointer};
-            auto sol = Solution{r.nonce, mix, w, std::chrono::steady_clock::now(), m_index};
-
-            cpulog << EthWhite << "Job: " << w.header.abridged()
-                   << " Sol: " << toHex(sol.nonce, HexPrefix::Add) << EthReset;
-            Farm::f().submitProof(sol);
+            if (!snapshot->claim(range))
+            {
+                ledger.flush();
+                waitForKick();
+            }
+            nonce = range.start;
+            continue;
         }
-        nonce += blocksize;
+        nonce = todo.start;
+
+        unsigned batch = (unsigned)std::min((uint64_t)m_batch, todo.size());
+        auto start = std::chrono::steady_clock::now();
+        unsigned count = m_kernel.search(job, nonce, batch, found, c_maxFound);
+        auto busy = std::chrono::steady_clock::now() - start;
+        adaptBatch(busy);
+        submitFound(shared, found, count);
+        ledger.add(nonce, batch);
+        rest(m_throttle.pace(busy));
+        nonce += batch;
 
         // Update the hash rate
-        updateHashRate(blocksize, 1);
+        updateHashRate(1, batch);
     }
 }
 
 
+/* ######################## Pool mode ######################## */
+
 /*
- * The main work loop of a Worker thread
+ * Nonce range owned by a pool thread. Idle peers steal chunks from its
+ * front with the very same atomic increment the owner uses, so each
+ * chunk is hashed once. Padded to keep owners off each other's cache line
  */
-void CPUMiner::workLoop()
+struct CPUMiner::PoolRange
 {
-    DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::workLoop() begin");
+    std::atomic<uint64_t> next;  // Offset of next chunk from job's start nonce
+    uint64_t end;
+    char pad[48];
+};
 
-    WorkPackage current;
-    current.header = h256();
+/*
+ * A job as seen by pool threads. Replaced, never modified, on job change
+ * thus threads still finishing their chunk on the previous job never
+ * touch the ranges of the new one
+ */
+struct CPUMiner::PoolJob
+{
+    PoolJob(WorkPackage const& _w, std::shared_ptr<const WorkPackage> const& _work,
+        std::shared_ptr<const WorkSnapshot> const& _snapshot, NonceRange const& _range,
+        unsigned _threads, uint64_t _chunk)
+      : work(_work),
+        snapshot(_snapshot),
+        startNonce(_range.start),
+        threads(_threads),
+        chunk(_chunk),
+        ranges(new PoolRange[_threads])
+    {
+        keccakSearchPrepare(job, _w);
 
-    if (!initDevice())
-        return;
+        // Device range is split evenly in whole chunks, last thread
+        // taking the remainder
+        uint64_t size = _range.size() / threads / chunk * chunk;
+        for (unsigned i = 0; i < threads; i++)
+        {
+            ranges[i].next = i * size;
+            ranges[i].end = i + 1 < threads ? (i + 1) * size : _range.size();
+        }
+    }
 
-    while (!shouldStop())
+    /*
+     * Offset of the next chunk thread _thread should hash: from its own
+     * range, else from the peer with most nonces left. Chunks at the end
+     * of a range may be shorter
+     * @return false when the device range is all claimed
+     */
+    bool claim(unsigned _thread, uint64_t& _offset, uint64_t& _count)
     {
-        // Wait for work or 3 seconds (whichever the first)
-        const WorkPackage w = work();
-        if (!w)
+        PoolRange& own = ranges[_thread];
+        if (own.next.load(std::memory_order_relaxed) < own.end)
         {
-            boost::system_time const timeout =
-                boost::get_system_time() + boost::posix_time::seconds(3);
-            boost::mutex::scoped_lock l(x_work);
-            m_new_work_signal.timed_wait(l, timeout);
-            continue;
+            _offset = own.next.fetch_add(chunk, std::memory_order_relaxed);
+            if (_offset < own.end)
+            {
+                _count = std::min(chunk, own.end - _offset);
+                return true;
+            }
         }
 
-        if (w.algo == "ethash")
+        while (true)
         {
-            // Epoch change ?
-            if (current.epoch != w.epoch)
+            unsigned victim = threads;
+            uint64_t left = 0;
+            for (unsigned i = 0; i < threads; i++)
+            {
+                uint64_t next = ranges[i].next.load(std::memory_order_relaxed);
+                if (next < ranges[i].end && ranges[i].end - next > left)
+                {
+                    victim = i;
+                    left = ranges[i].end - next;
+                }
+            }
+            if (victim == threads)
+                return false;
+            _offset = ranges[victim].next.fetch_add(chunk, std::memory_order_relaxed);
+            if (_offset < ranges[victim].end)
             {
-                if (!initEpoch())
-                    break;  // This will simply exit the thread
-
-                // As DAG generation takes a while we need to
-                // ensure we're on latest job, not on the one
-                // which triggered the epoch change
-                current = w;
-                continue;
+                _count = std::min(chunk, ranges[victim].end - _offset);
+                return true;
             }
+        }
+    }
 
-            // Persist most recent job.
-            // Job's differences should be handled at higher level
-            current = w;
+    std::shared_ptr<const WorkPackage> work;       // Shared by solutions found on it
+    std::shared_ptr<const WorkSnapshot> snapshot;  // Follow-up ranges are claimed from it
+    uint64_t startNonce;                           // Start of this device's range
+    KeccakSearchJob job;
+    unsigned threads;
+    uint64_t chunk;  // Nonces claimed at once. Fixed for the job so chunks never overlap
+    std::unique_ptr<PoolRange[]> ranges;
+};
 
-            // Start searching
-            search(w);
+
+void CPUMiner::startPool()
+{
+    m_poolStop = false;
+    for (unsigned i = 1; i < m_placements.size(); i++)
+        m_poolThreads.emplace_back(&CPUMiner::poolLoop, this, i);
+}
+
+
+void CPUMiner::stopPool()
+{
+    {
+        boost::mutex::scoped_lock l(x_pool);
+        m_poolStop = true;
+        m_poolJob.reset();
+        m_poolGen++;
+    }
+    m_poolSignal.notify_all();
+    for (auto& thread : m_poolThreads)
+        thread.join();
+    m_poolThreads.clear();
+}
+
+
+/*
+ * Pool thread 0 side of a job : publishes it to the others then hashes
+ * along with them till the job is kicked
+ */
+void CPUMiner::searchPool(const WorkPackage& _w)
+{
+    // Chunk size follows the batch size thread 0 adapted on previous jobs
+    auto job = std::make_shared<PoolJob>(
+        _w, workJob(), workSnapshot(), workRange(), m_placements.size(), m_batch);
+    unsigned gen;
+    {
+        boost::mutex::scoped_lock l(x_pool);
+        m_poolJob = job;
+        gen = ++m_poolGen;
+    }
+    m_poolSignal.notify_all();
+
+    hashPool(*job, 0, gen);
+    m_new_work.store(false, std::memory_order_relaxed);
+}
+
+
+void CPUMiner::poolLoop(unsigned _thread)
+{
+    setThreadName((m_deviceDescriptor.uniqueId + "." + std::to_string(_thread)).c_str());
+    bindThread(m_placements[_thread].affinity);
+    m_throttle.applyPriority();
+    if (m_settings.counters)
+        openCounters();
+
+    unsigned gen = 0;
+    while (true)
+    {
+        std::shared_ptr<PoolJob> job;
+        {
+            boost::mutex::scoped_lock l(x_pool);
+            while (!m_poolStop && (!m_poolJob || m_poolGen == gen))
+                m_poolSignal.wait(l);
+            if (m_poolStop)
+                break;
+            job = m_poolJob;
+            gen = m_poolGen;
         }
+        hashPool(*job, _thread, gen);
+    }
+}
+
+
+/*
+ * Hashes chunks of the job till it changes. Generation is checked
+ * before every chunk so a kick is honoured within one chunk
+ */
+void CPUMiner::hashPool(PoolJob& _job, unsigned _thread, unsigned _gen)
+{
+    uint64_t found[c_maxFound];
+    NonceLedgerView ledger(*_job.snapshot->ledger);
+    NonceRange extra = {0, 0};  // Follow-up range once the device's one is claimed
+
+    while (m_poolGen.load(std::memory_order_relaxed) == _gen && !shouldStop())
+    {
+        uint64_t nonce, size;
+        if (_job.claim(_thread, nonce, size))
+            nonce += _job.startNonce;
         else
         {
-            throw std::runtime_error("Algo : " + w.algo + " not yet implemented");
+            if (!extra.size() && !_job.snapshot->claim(extra))
+            {
+                // Thread 0 stays in charge of the device till kicked
+                ledger.flush();
+                if (_thread == 0)
+                    waitForKick();
+                return;
+            }
+            nonce = extra.start;
+            size = std::min(_job.chunk, extra.size());
+            extra.start += size;
+        }
+
+        // Skip nonces of the chunk scanned before a pause or a restart
+        NonceRange left = {nonce, nonce + size};
+        for (NonceRange todo = ledger.uncovered(left);
+             todo.size() && m_poolGen.load(std::memory_order_relaxed) == _gen;
+             todo = ledger.uncovered(left))
+        {
+            auto start = std::chrono::steady_clock::now();
+            unsigned count =
+                m_kernel.search(_job.job, todo.start, (unsigned)todo.size(), found, c_maxFound);
+            auto busy = std::chrono::steady_clock::now() - start;
+            if (_thread == 0)
+                adaptBatch(busy);
+            submitFound(_job.work, found, count);
+            ledger.add(todo.start, todo.size());
+            restPool(m_throttle.pace(busy), _gen);
+            left.start = todo.end;
+
+            // Every thread adds to the device's counter
+            updateHashRate(1, (uint32_t)todo.size());
+        }
+    }
+
+    // Kicked : nonces scanned so far reach the ledger before the next
+    // job's views are taken
+    ledger.flush();
+}
+
+
+/*
+ * Throttling rest of a pool thread, cut short when the job changes
+ */
+void CPUMiner::restPool(std::chrono::steady_clock::duration _time, unsigned _gen)
+{
+    if (_time <= std::chrono::steady_clock::duration::zero())
+        return;
+    boost::system_time const until =
+        boost::get_system_time() +
+        boost::posix_time::microseconds(
+            std::chrono::duration_cast<std::chrono::microseconds>(_time).count());
+    boost::mutex::scoped_lock l(x_pool);
+    while (m_poolGen.load(std::memory_order_relaxed) == _gen && !m_poolStop && !shouldStop())
+        if (!m_poolSignal.timed_wait(l, until))
+            break;
+}
+
+
+/*
+ * The main work loop of a Worker thread
+ */
+void CPUMiner::workLoop()
+{
+    DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::workLoop() begin");
+
+    if (!initDevice())
+        return;
+
+    while (!shouldStop())
+    {
+        // Wait for work, resume or 3 seconds (whichever the first)
+        WorkPackage const& w = work();
+        if (!w)
+        {
+            waitForWork();
+            continue;
         }
+
+        // Every job is hashed with Keccak-256 straight away, whatever algo
+        // label the pool layer carries: no epoch initialization is needed
+        if (m_settings.pool)
+            searchPool(w);
+        else
+            search(w);
     }
 
+    if (m_settings.pool)
+        stopPool();
+
     DEV_BUILD_LOG_PROGRAMFLOW(cpulog, "cp-" << m_index << " CPUMiner::workLoop() end");
 }
 
 
-void CPUMiner::enumDevices(std::map<string, DeviceDescriptor>& _DevicesCollection)
+void CPUMiner::enumDevices(
+    std::map<string, DeviceDescriptor>& _DevicesCollection, CPSettings const& _settings)
 {
-    unsigned numDevices = getNumDevices();
+    vector<CpuPlacement> placements = cpuPlacements(_settings);
+
+    // Pool mode exposes a single device spanning all placements
+    if (_settings.pool && placements.size())
+    {
+        CpuPlacement pool = placements.front();
+        pool.affinity.clear();
+        for (auto const& placement : placements)
+            pool.affinity.push_back(placement.cpu.id);
+        placements.assign(1, pool);
+    }
 
-    for (unsigned i = 0; i < numDevices; i++)
+    for (auto const& placement : placements)
     {
         string uniqueId;
         ostringstream s;
         DeviceDescriptor deviceDescriptor;
 
-        s << "cpu-" << i;
+        if (_settings.pool)
+            s << "cpu-pool";
+        else
+            s << "cpu-" << placement.cpu.id;
         uniqueId = s.str();
         if (_DevicesCollection.find(uniqueId) != _DevicesCollection.end())
             deviceDescriptor = _DevicesCollection[uniqueId];
@@ -373,14 +793,17 @@ void CPUMiner::enumDevices(std::map<string, DeviceDescriptor>& _DevicesCollectio
 
         s.str("");
         s.clear();
-        s << "ethash::eval()/boost " << (BOOST_VERSION / 100000) << "."
-          << (BOOST_VERSION / 100 % 1000) << "." << (BOOST_VERSION % 100);
+        s << "keccak256/" << keccakSearchKernel().name << " boost " << (BOOST_VERSION / 100000)
+          << "." << (BOOST_VERSION / 100 % 1000);
         deviceDescriptor.name = s.str();
         deviceDescriptor.uniqueId = uniqueId;
         deviceDescriptor.type = DeviceTypeEnum::Cpu;
         deviceDescriptor.totalMemory = getTotalPhysAvailableMemory();
 
-        deviceDescriptor.cpCpuNumer = i;
+        deviceDescriptor.cpCpuNumer = placement.cpu.id;
+        deviceDescriptor.cpCore = placement.cpu.core;
+        deviceDescriptor.cpNode = placement.cpu.node;
+        deviceDescriptor.cpAffinity = placement.affinity;
 
         _DevicesCollection[uniqueId] = deviceDescriptor;
     }
@@ -21,7 +21,15 @@ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
 #include <libkeccakcore/KeccakAux.h>
 #include <libkeccakcore/Miner.h>
 
+#include "CPUCounters.h"
+#include "CPUThrottle.h"
+#include "CPUTopology.h"
+#include "KeccakSearch.h"
+
+#include <chrono>
 #include <functional>
+#include <memory>
+#include <thread>
 
 namespace dev
 {
@@ -34,9 +42,14 @@ public:
     ~CPUMiner() override;
 
     static unsigned getNumDevices();
-    static void enumDevices(std::map<string, DeviceDescriptor>& _DevicesCollection);
+    static void enumDevices(
+        std::map<string, DeviceDescriptor>& _DevicesCollection, CPSettings const& _settings);
+
+    void search(const WorkPackage& w);
 
-    void search(const dev::eth::WorkPackage& w);
+    HwCountersType RetrieveCounters() override;
+
+    bool honoursRange() const override { return true; }
 
 protected:
     bool initDevice() override;
@@ -44,9 +57,44 @@ protected:
     void kick_miner() override;
 
 private:
+    struct PoolRange;
+    struct PoolJob;
+
     atomic<bool> m_new_work = {false};
     void workLoop() override;
+    void bindThread(std::vector<unsigned> const& _cpus);
+    void adaptBatch(std::chrono::steady_clock::duration _busy);
+    void waitForKick();
+    void rest(std::chrono::steady_clock::duration _time);
+    void submitFound(
+        std::shared_ptr<const WorkPackage> const& _w, uint64_t const* _found, unsigned _count);
+    void openCounters();
+
+    // Pool mode : the worker thread is pool thread 0 and drives the others
+    void startPool();
+    void stopPool();
+    void searchPool(WorkPackage const& _w);
+    void poolLoop(unsigned _thread);
+    void hashPool(PoolJob& _job, unsigned _thread, unsigned _gen);
+    void restPool(std::chrono::steady_clock::duration _time, unsigned _gen);
+
     CPSettings m_settings;
+    KeccakSearchKernel m_kernel = keccakSearchKernels().front();
+    unsigned m_batch = 32;  // Nonces per kernel call. Only the worker thread adapts it
+    CPUThrottle m_throttle;
+
+    std::vector<CpuPlacement> m_placements;  // One per pool thread
+    std::vector<std::thread> m_poolThreads;  // Pool threads 1..n
+    boost::mutex x_pool;
+    boost::condition_variable m_poolSignal;
+    std::shared_ptr<PoolJob> m_poolJob;     // Job being hashed. Null when idle
+    std::atomic<unsigned> m_poolGen = {0};  // Bumped on every job change
+    bool m_poolStop = false;
+
+    boost::mutex x_counters;
+    std::vector<std::unique_ptr<PerfCounters>> m_counters;  // One per hash thread
+    PerfSample m_lastSample;                  // Sum of counters at previous retrieval
+    uint64_t m_lastHashes = 0;                // Hash count at previous retrieval
 };
 
 
@@ -0,0 +1,140 @@
+/*
+This file is part of keccakminer.
+
+keccakminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+keccakminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(__linux__)
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* we need SCHED_IDLE */
+#endif
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include <libdevcore/Log.h>
+
+#include "CPUThrottle.h"
+
+using namespace std;
+using namespace dev;
+using namespace etc;
+
+namespace
+{
+constexpr unsigned c_minShare = 5;     // Never back off below this share
+constexpr unsigned c_recoverStep = 10;  // Share regained per uncontended second
+
+}  // namespace
+
+namespace dev
+{
+namespace etc
+{
+bool cpuContended(unsigned _pressure)
+{
+#if defined(__linux__)
+    // some avg10=1.23 avg60=0.50 avg300=0.10 total=123456
+    ifstream psi("/proc/pressure/cpu");
+    string line;
+    if (psi && getline(psi, line) && line.compare(0, 4, "some") == 0)
+    {
+        size_t pos = line.find("avg10=");
+        if (pos != string::npos)
+            return atof(line.c_str() + pos + 6) > _pressure;
+    }
+
+    // 0.52 0.58 0.59 3/561 12345 : 4th field is runnable/total tasks
+    ifstream loadavg("/proc/loadavg");
+    double load[3];
+    unsigned running = 0;
+    if (loadavg >> load[0] >> load[1] >> load[2] >> running)
+        return running > std::thread::hardware_concurrency();
+#else
+    (void)_pressure;
+#endif
+    return false;
+}
+
+CPUThrottle::CPUThrottle(CPSettings const& _settings)
+  : m_settings(_settings), m_share(_settings.share)
+{}
+
+void CPUThrottle::applyPriority()
+{
+#if defined(__linux__)
+    if (m_settings.idle)
+    {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        if (sched_setscheduler(0, SCHED_IDLE, &param) != 0)
+            cwarn << "Error in func " << __FUNCTION__ << " at sched_setscheduler() \""
+                  << strerror(errno) << "\"";
+    }
+    // Nice applies to a single thread when given its tid
+    if (m_settings.nice &&
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), m_settings.nice) != 0)
+        cwarn << "Error in func " << __FUNCTION__ << " at setpriority() \"" << strerror(errno)
+              << "\"";
+#elif defined(_WIN32)
+    if (m_settings.idle || m_settings.nice > 0)
+        SetThreadPriority(GetCurrentThread(),
+            m_settings.idle ? THREAD_PRIORITY_IDLE : THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+}
+
+std::chrono::steady_clock::duration CPUThrottle::pace(std::chrono::steady_clock::duration _busy)
+{
+    using namespace std::chrono;
+
+    if (m_settings.pressure)
+    {
+        // One thread at a time checks contention, once per second
+        int64_t now = steady_clock::now().time_since_epoch().count();
+        int64_t next = m_nextSample.load(std::memory_order_relaxed);
+        if (now >= next &&
+            m_nextSample.compare_exchange_strong(
+                next, now + duration_cast<steady_clock::duration>(seconds(1)).count()))
+            sample();
+    }
+
+    unsigned share = m_share.load(std::memory_order_relaxed);
+    if (share < 100)
+        return _busy * (100 - share) / share;
+    return steady_clock::duration::zero();
+}
+
+void CPUThrottle::sample()
+{
+    unsigned share = m_share.load(std::memory_order_relaxed);
+    if (cpuContended(m_settings.pressure))
+        share = std::min(std::max(share / 2, c_minShare), m_settings.share);
+    else
+        share = std::min(share + c_recoverStep, m_settings.share);
+    m_share.store(share, std::memory_order_relaxed);
+}
+
+}  // namespace etc
+}  // namespace dev
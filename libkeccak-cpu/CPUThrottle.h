@@ -0,0 +1,74 @@
+/*
+This file is part of keccakminer.
+
+keccakminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+keccakminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+#include <libkeccakcore/Miner.h>
+
+namespace dev
+{
+namespace etc
+{
+/**
+ * @brief Keeps CPU hash threads out of the way of other workloads on the host.
+ * Threads report how long they hashed and rest long enough to stay within
+ * the CPU share set in CPSettings. When a pressure threshold is set that
+ * share is halved each second the host shows contention and then recovers
+ * in 10% steps once contention is gone.
+ * @threadsafe
+ */
+class CPUThrottle
+{
+public:
+    CPUThrottle(CPSettings const& _settings);
+
+    /**
+     * @brief Applies scheduling class and nice level to the calling thread
+     */
+    void applyPriority();
+
+    /**
+     * @brief Time the calling thread should rest after _busy spent hashing.
+     * Caller waits it out on its kick signal, so new work still cuts it short
+     */
+    std::chrono::steady_clock::duration pace(std::chrono::steady_clock::duration _busy);
+
+    /**
+     * @brief CPU share (percent) hash threads are currently allowed
+     */
+    unsigned share() const { return m_share.load(std::memory_order_relaxed); }
+
+private:
+    void sample();
+
+    CPSettings m_settings;
+    std::atomic<unsigned> m_share;
+    std::atomic<int64_t> m_nextSample = {0};  // Steady clock ticks of next contention check
+};
+
+/**
+ * @brief Whether or not the host CPUs are contended.
+ * Uses "some avg10" of /proc/pressure/cpu when the kernel supports PSI,
+ * else runnable tasks of /proc/loadavg against online CPUs
+ */
+bool cpuContended(unsigned _pressure);
+
+}  // namespace etc
+}  // namespace dev
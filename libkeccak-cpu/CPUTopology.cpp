@@ -0,0 +1,228 @@
+/*
+This file is part of keccakminer.
+
+keccakminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+keccakminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if defined(__linux__)
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* we need sched_getaffinity() */
+#endif
+#include <dirent.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include <libdevcore/Log.h>
+
+#include "CPUTopology.h"
+
+using namespace std;
+using namespace dev;
+using namespace etc;
+
+namespace
+{
+#if defined(__linux__)
+const char* c_sysCpu = "/sys/devices/system/cpu";
+
+// First line of a sysfs file. Empty if it can't be read
+string readSysFile(string const& _path)
+{
+    ifstream f(_path);
+    string line;
+    if (f)
+        getline(f, line);
+    return line;
+}
+
+unsigned readSysUnsigned(string const& _path, unsigned _default)
+{
+    string value = readSysFile(_path);
+    if (value.empty())
+        return _default;
+    try
+    {
+        return (unsigned)stoul(value);
+    }
+    catch (const std::exception&)
+    {
+        return _default;
+    }
+}
+
+// NUMA node of a logical CPU is given by its nodeN link
+unsigned cpuNode(unsigned _cpu)
+{
+    unsigned node = 0;
+    string path = string(c_sysCpu) + "/cpu" + to_string(_cpu);
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+        return node;
+    while (struct dirent* entry = readdir(dir))
+    {
+        if (strncmp(entry->d_name, "node", 4) == 0 && isdigit(entry->d_name[4]))
+        {
+            node = (unsigned)atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+#endif
+
+}  // namespace
+
+namespace dev
+{
+namespace etc
+{
+vector<unsigned> parseCpuList(string const& _list)
+{
+    vector<unsigned> cpus;
+    stringstream ss(_list);
+    string range;
+    while (getline(ss, range, ','))
+    {
+        if (range.empty() || !isdigit(range[0]))
+            continue;
+        size_t dash = range.find('-');
+        unsigned first = (unsigned)stoul(range.substr(0, dash));
+        unsigned last = dash == string::npos ? first : (unsigned)stoul(range.substr(dash + 1));
+        for (unsigned cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+vector<CpuInfo> cpuTopology(bool _online)
+{
+    vector<CpuInfo> cpus;
+
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    set<unsigned> isolated;
+    if (_online)
+    {
+        for (auto cpu : parseCpuList(readSysFile(string(c_sysCpu) + "/online")))
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &allowed);
+    }
+    else
+    {
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        {
+            cwarn << "Error in func " << __FUNCTION__ << " at sched_getaffinity() \""
+                  << strerror(errno) << "\"";
+            for (unsigned i = 0; i < std::thread::hardware_concurrency(); i++)
+                CPU_SET(i, &allowed);
+        }
+        for (auto cpu : parseCpuList(readSysFile(string(c_sysCpu) + "/isolated")))
+            isolated.insert(cpu);
+    }
+
+    // Cores ids are only unique within a package
+    map<pair<unsigned, unsigned>, unsigned> cores;
+    for (unsigned id = 0; id < CPU_SETSIZE; id++)
+    {
+        if (!CPU_ISSET(id, &allowed) || isolated.count(id))
+            continue;
+
+        string topology = string(c_sysCpu) + "/cpu" + to_string(id) + "/topology/";
+        CpuInfo cpu;
+        cpu.id = id;
+        cpu.package = readSysUnsigned(topology + "physical_package_id", 0);
+        auto key = make_pair(cpu.package, readSysUnsigned(topology + "core_id", id));
+        auto core = cores.find(key);
+        if (core == cores.end())
+            core = cores.insert(make_pair(key, (unsigned)cores.size())).first;
+        cpu.core = core->second;
+        cpu.node = cpuNode(id);
+        cpus.push_back(cpu);
+    }
+#else
+    (void)_online;
+    unsigned count = std::thread::hardware_concurrency();
+    for (unsigned id = 0; id < count; id++)
+        cpus.push_back(CpuInfo{id, id, 0, 0});
+#endif
+
+    return cpus;
+}
+
+vector<CpuPlacement> cpuPlacements(CPSettings const& _settings)
+{
+    // Explicitly listed CPUs may be isolated ones
+    vector<CpuInfo> cpus = cpuTopology(_settings.policy == CpuPolicyEnum::List);
+    vector<CpuPlacement> placements;
+
+    switch (_settings.policy)
+    {
+    case CpuPolicyEnum::Core:
+    {
+        // First allowed sibling of each core
+        set<unsigned> seen;
+        for (auto const& cpu : cpus)
+            if (seen.insert(cpu.core).second)
+                placements.push_back(CpuPlacement{cpu, {cpu.id}});
+        break;
+    }
+
+    case CpuPolicyEnum::Numa:
+    {
+        map<unsigned, vector<unsigned>> nodes;
+        for (auto const& cpu : cpus)
+            nodes[cpu.node].push_back(cpu.id);
+        for (auto const& cpu : cpus)
+            placements.push_back(CpuPlacement{cpu, nodes[cpu.node]});
+        break;
+    }
+
+    case CpuPolicyEnum::List:
+        for (auto id : _settings.cpus)
+        {
+            auto cpu = find_if(
+                cpus.begin(), cpus.end(), [id](CpuInfo const& _cpu) { return _cpu.id == id; });
+            if (cpu == cpus.end())
+            {
+                cwarn << "CPU " << id << " is offline. Skipping";
+                continue;
+            }
+            placements.push_back(CpuPlacement{*cpu, {cpu->id}});
+        }
+        break;
+
+    case CpuPolicyEnum::Logical:
+    default:
+        for (auto const& cpu : cpus)
+            placements.push_back(CpuPlacement{cpu, {cpu.id}});
+        break;
+    }
+
+    return placements;
+}
+
+}  // namespace etc
+}  // namespace dev
@@ -0,0 +1,69 @@
+/*
+This file is part of keccakminer.
+
+keccakminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+keccakminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <libkeccakcore/Miner.h>
+
+namespace dev
+{
+namespace etc
+{
+/**
+ * @brief A logical CPU this process is allowed to run on
+ */
+struct CpuInfo
+{
+    unsigned id;       // Logical CPU id as known by the OS
+    unsigned core;     // Physical core, unique across packages
+    unsigned package;  // Physical package (socket)
+    unsigned node;     // NUMA node
+};
+
+/**
+ * @brief Where a CPU miner thread runs
+ */
+struct CpuPlacement
+{
+    CpuInfo cpu;                     // Primary logical CPU
+    std::vector<unsigned> affinity;  // Logical CPUs the thread may be scheduled on
+};
+
+/**
+ * @brief Logical CPUs this process may use, sorted by id.
+ * On Linux read from /sys/devices/system/cpu and restricted to the
+ * sched_getaffinity() mask (thus to cgroup cpusets and taskset) and
+ * to non isolated CPUs, unless _online asks for every online CPU.
+ * Elsewhere every logical CPU is reported as its own core on node 0.
+ */
+std::vector<CpuInfo> cpuTopology(bool _online = false);
+
+/**
+ * @brief One placement per CPU miner thread according to the settings' policy
+ */
+std::vector<CpuPlacement> cpuPlacements(CPSettings const& _settings);
+
+/**
+ * @brief Parses a Linux cpu list (eg "0-3,8,10-11")
+ */
+std::vector<unsigned> parseCpuList(std::string const& _list);
+
+}  // namespace etc
+}  // namespace dev
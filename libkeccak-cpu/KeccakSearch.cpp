@@ -0,0 +1,568 @@
+/*
+This file is part of keccakminer.
+
+keccakminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+keccakminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ Native Keccak-256 search for CPU miners.
+
+ Message is the 32 bytes header hash followed by the 8 bytes nonce
+ in big-endian order (see KeccakAux::eval). 40 bytes fit in one
+ 136 bytes block thus a single Keccak-f[1600] permutation is needed:
+
+   lanes 0..3   header hash
+   lane  4      nonce (byte swapped)
+   lane  5      padding byte of KeccakSearchFormat (0x01 Keccak)
+   lane  16     0x80 final padding bit
+*/
+
+#include <chrono>
+
+#include <libkeccakcore/KeccakRounds.h>
+
+#include "KeccakSearch.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <stdlib.h>
+#endif
+
+using namespace std;
+using namespace dev;
+using namespace etc;
+
+namespace
+{
+// Overall time spent benchmarking kernels at startup
+const unsigned c_benchmarkMs = 200;
+
+typedef KeccakRounds<> Rounds;
+typedef KeccakFormatHash<KeccakSearchFormat> GenericHash;
+
+inline uint64_t rotl64(uint64_t _x, unsigned _n)
+{
+    return (_x << _n) | (_x >> (64 - _n));
+}
+
+inline uint64_t bswap64(uint64_t _x)
+{
+#if defined(_MSC_VER)
+    return _byteswap_uint64(_x);
+#else
+    return __builtin_bswap64(_x);
+#endif
+}
+
+inline uint64_t loadLane(const byte* _p)
+{
+    uint64_t lane = 0;
+    for (unsigned i = 0; i < 8; i++)
+        lane |= (uint64_t)_p[i] << (8 * i);
+    return lane;
+}
+
+inline void storeLane(byte* _p, uint64_t _lane)
+{
+    for (unsigned i = 0; i < 8; i++)
+        _p[i] = (byte)(_lane >> (8 * i));
+}
+
+/*
+ Round 0 out of the job's midstate.
+
+ Before round 0 only lane 4 depends on the nonce, thus column parities
+ are C[0] = H0 ^ 1, C[1] = H1 ^ P, C[2] = H2, C[3] = H3, C[4] = N and
+ only theta D[0] = N ^ rotl(C[1], 1) and D[3] = H2 ^ rotl(N, 1) vary.
+ Columns 1, 2 and 4 (but lane 4 itself) are constant after theta and so
+ are the 14 lanes rho/pi moves them to. Here only the 11 nonce dependent
+ lanes are placed and chi is computed, skipping chi terms which depend
+ on constant lanes only.
+*/
+inline void keccakRound0(KeccakSearchJob const& _job, uint64_t _nonce, uint64_t* a)
+{
+    const uint64_t* b = _job.rhoPi;
+    const uint64_t n = bswap64(_nonce);
+    const uint64_t d0 = n ^ _job.theta0;
+    const uint64_t d3 = _job.header[2] ^ rotl64(n, 1);
+
+    const uint64_t b0 = _job.header[0] ^ d0;
+    const uint64_t b3 = rotl64(d3, 21);
+    const uint64_t b5 = rotl64(_job.header[3] ^ d3, 28);
+    const uint64_t b7 = rotl64(d0, 3);
+    const uint64_t b12 = rotl64(d3, 25);
+    const uint64_t b14 = rotl64(d0, 18);
+    const uint64_t b15 = rotl64(n ^ _job.theta4, 27);
+    const uint64_t b16 = rotl64(d0 ^ KeccakSearchFormat::pad, 36);
+    const uint64_t b19 = rotl64(d3, 56);
+    const uint64_t b21 = rotl64(d3, 55);
+    const uint64_t b23 = rotl64(d0, 41);
+
+    // chi and iota (folded in _job.chi[0])
+    a[0] = b0 ^ _job.chi[0];
+    a[1] = b[1] ^ (~b[2] & b3);
+    a[2] = b[2] ^ (~b3 & b[4]);
+    a[3] = b3 ^ (~b[4] & b0);
+    a[4] = b[4] ^ (~b0 & b[1]);
+
+    a[5] = b5 ^ (~b[6] & b7);
+    a[6] = b[6] ^ (~b7 & b[8]);
+    a[7] = b7 ^ _job.chi[7];
+    a[8] = b[8] ^ (~b[9] & b5);
+    a[9] = b[9] ^ (~b5 & b[6]);
+
+    a[10] = b[10] ^ (~b[11] & b12);
+    a[11] = b[11] ^ (~b12 & b[13]);
+    a[12] = b12 ^ (~b[13] & b14);
+    a[13] = b[13] ^ (~b14 & b[10]);
+    a[14] = b14 ^ _job.chi[14];
+
+    a[15] = b15 ^ (~b16 & b[17]);
+    a[16] = b16 ^ _job.chi[16];
+    a[17] = b[17] ^ (~b[18] & b19);
+    a[18] = b[18] ^ (~b19 & b15);
+    a[19] = b19 ^ (~b15 & b16);
+
+    a[20] = b[20] ^ (~b21 & b[22]);
+    a[21] = b21 ^ (~b[22] & b23);
+    a[22] = b[22] ^ (~b23 & b[24]);
+    a[23] = b23 ^ _job.chi[23];
+    a[24] = b[24] ^ (~b[20] & b21);
+}
+
+// N interleaved states flavour of keccakSearch
+template <unsigned N>
+unsigned keccakSearchN(KeccakSearchJob const& _job, uint64_t _startNonce, unsigned _count,
+    uint64_t* _found, unsigned _maxFound)
+{
+    unsigned found = 0;
+    unsigned i = 0;
+    uint64_t single[25];
+    uint64_t state[25][N];
+
+    for (; i + N <= _count; i += N)
+    {
+        for (unsigned k = 0; k < N; k++)
+        {
+            keccakRound0(_job, _startNonce + i + k, single);
+            for (unsigned l = 0; l < 25; l++)
+                state[l][k] = single[l];
+        }
+        Rounds::permuteN<1, 1, N>(state);
+
+        for (unsigned k = 0; k < N; k++)
+        {
+            if (bswap64(state[0][k]) > _job.target)
+                continue;
+            const uint64_t nonce = _startNonce + i + k;
+            if (keccakSearchHash(_job, nonce) <= _job.boundary && found < _maxFound)
+                _found[found++] = nonce;
+        }
+    }
+
+    // Leftovers
+    if (i < _count)
+        found += keccakSearch(_job, _startNonce + i, _count - i, _found + found, _maxFound - found);
+
+    return found;
+}
+
+inline void keccakHashNonce(KeccakSearchJob const& _job, uint64_t _nonce, uint64_t* a)
+{
+    keccakRound0(_job, _nonce, a);
+    Rounds::permute<1, 4>(a);
+}
+
+inline h256 digestFromLanes(const uint64_t* a)
+{
+    h256 digest;
+    for (unsigned i = 0; i < 4; i++)
+        storeLane(digest.data() + i * 8, a[i]);
+    return digest;
+}
+
+// Hashes per second of a kernel measured during roughly _ms milliseconds
+double benchmarkKernel(KeccakSearchKernel const& _kernel, unsigned _ms)
+{
+    const unsigned batch = 4096;
+
+    WorkPackage wp;
+    for (unsigned i = 0; i < wp.header.size; i++)
+        wp.header[i] = (byte)(i * 151 + 7);
+    KeccakSearchJob job;
+    keccakSearchPrepare(job, wp);  // Boundary is zero : nothing to find
+    uint64_t found[1];
+
+    // Warm up caches and clocks before timing
+    uint64_t nonce = 0;
+    _kernel.search(job, nonce, batch, found, 1);
+    nonce += batch;
+
+    const auto start = chrono::steady_clock::now();
+    const auto budget = chrono::milliseconds(_ms);
+    uint64_t hashes = 0;
+    chrono::steady_clock::duration elapsed;
+    do
+    {
+        _kernel.search(job, nonce, batch, found, 1);
+        nonce += batch;
+        hashes += batch;
+        elapsed = chrono::steady_clock::now() - start;
+    } while (elapsed < budget);
+
+    return hashes / chrono::duration<double>(elapsed).count();
+}
+
+// Runs once : keeps kernels this host can run and which pass the
+// self test then picks the fastest one
+KeccakSearchKernel pickKernel()
+{
+    vector<KeccakSearchKernel> candidates;
+    for (auto const& kernel : keccakSearchKernels())
+        if (kernel.supported() && keccakSearchSelfTest(kernel))
+            candidates.push_back(kernel);
+
+    // Scalar kernel is first and always there
+    if (candidates.empty())
+        return keccakSearchKernels().front();
+
+    KeccakSearchKernel best = candidates.front();
+    double bestRate = 0;
+    for (auto const& kernel : candidates)
+    {
+        double rate = benchmarkKernel(kernel, c_benchmarkMs / (unsigned)candidates.size());
+        if (rate > bestRate)
+        {
+            best = kernel;
+            bestRate = rate;
+        }
+    }
+    best.hashRate = bestRate;
+    return best;
+}
+
+// SHA3-256 of a format's message for nonce 0x0123456789abcdef, header
+// byte i being i * _seed + 3, must match the reference digest
+template <typename Format>
+bool formatSelfTest(unsigned _seed, char const* _digest)
+{
+    const uint64_t nonce = 0x0123456789abcdefULL;
+    byte header[Format::headerBytes];
+    for (unsigned i = 0; i < Format::headerBytes; i++)
+        header[i] = (byte)(i * _seed + 3);
+
+    KeccakFormatJob<Format> job;
+    KeccakFormatHash<Format>::prepare(job, bytesConstRef(header, sizeof(header)), h256());
+    const h256 digest = KeccakFormatHash<Format>::hash(job, nonce);
+    uint64_t upper = 0;
+    for (unsigned i = 0; i < 8; i++)
+        upper = (upper << 8) | digest[i];
+    return digest == h256(_digest) && KeccakFormatHash<Format>::upper(job, nonce) == upper;
+}
+
+// Non default formats: SHA3 padding, nonce across two lanes, midstate
+// with a little-endian nonce in the second block
+bool formatsSelfTest()
+{
+    return formatSelfTest<KeccakMessageFormat<32, 32, true, 0x06>>(
+               7, "e93c7b41d186fb2529aa66e6d098a72a1008b889cb365debc8c6b34fac7d9118") &&
+           formatSelfTest<KeccakMessageFormat<40, 12, true, 0x06>>(
+               11, "2cbb4ce2e2a82cc133948905c6bc0847f45d0ac3a152cad73aafc1f73bc96fd0") &&
+           formatSelfTest<KeccakMessageFormat<160, 144, false, 0x06>>(
+               13, "866d5fec53d1a09ead8800cf53b492e43ba21827a00eb4d28e4fe373110cddd5");
+}
+
+}  // namespace
+
+namespace dev
+{
+namespace etc
+{
+void keccakSearchPrepare(KeccakSearchJob& _job, WorkPackage const& _wp)
+{
+    const uint64_t pad = KeccakSearchFormat::pad;
+    const uint64_t padEnd = 0x8000000000000000ULL;
+
+    for (unsigned i = 0; i < 4; i++)
+        _job.header[i] = loadLane(_wp.header.data() + i * 8);
+    _job.boundary = _wp.boundary;
+    _job.target = 0;
+    for (unsigned i = 0; i < 8; i++)
+        _job.target = (_job.target << 8) | _wp.boundary[i];
+    GenericHash::prepare(_job.format, _wp.header.ref(), _wp.boundary);
+
+    const uint64_t* h = _job.header;
+    uint64_t* b = _job.rhoPi;
+
+    // theta: column parities and D values not depending on the nonce
+    const uint64_t c0 = h[0] ^ pad;
+    const uint64_t c1 = h[1] ^ padEnd;
+    const uint64_t d1 = c0 ^ rotl64(h[2], 1);
+    const uint64_t d2 = c1 ^ rotl64(h[3], 1);
+    const uint64_t d4 = h[3] ^ rotl64(c0, 1);
+    _job.theta0 = rotl64(c1, 1);
+    _job.theta4 = d4;
+
+    // rho pi: placement of the lanes which are constant after theta
+    for (unsigned i = 0; i < 25; i++)
+        b[i] = 0;
+    b[1] = rotl64(d1, 44);
+    b[2] = rotl64(d2, 43);
+    b[4] = rotl64(d4, 14);
+    b[6] = rotl64(d4, 20);
+    b[8] = rotl64(padEnd ^ d1, 45);
+    b[9] = rotl64(d2, 61);
+    b[10] = rotl64(h[1] ^ d1, 1);
+    b[11] = rotl64(d2, 6);
+    b[13] = rotl64(d4, 8);
+    b[17] = rotl64(d1, 10);
+    b[18] = rotl64(d2, 15);
+    b[20] = rotl64(h[2] ^ d2, 62);
+    b[22] = rotl64(d4, 39);
+    b[24] = rotl64(d1, 2);
+
+    // chi terms made of constant lanes only
+    for (unsigned i = 0; i < 25; i++)
+        _job.chi[i] = 0;
+    _job.chi[0] = (~b[1] & b[2]) ^ KeccakF1600Spec::rc[0];
+    _job.chi[7] = ~b[8] & b[9];
+    _job.chi[14] = ~b[10] & b[11];
+    _job.chi[16] = ~b[17] & b[18];
+    _job.chi[23] = ~b[24] & b[20];
+}
+
+h256 keccakSearchHash(KeccakSearchJob const& _job, uint64_t _nonce)
+{
+    uint64_t state[25];
+    keccakHashNonce(_job, _nonce, state);
+    return digestFromLanes(state);
+}
+
+bool keccakSearchSelfTest(KeccakSearchKernel const& _kernel)
+{
+    const uint64_t nonces[] = {0x0000000000000000ULL, 0x0000000000000001ULL,
+        0x00000000ffffffffULL, 0x0123456789abcdefULL, 0x8000000000000000ULL,
+        0xffffffffffffffffULL};
+    const unsigned count = 256;
+
+    if (!formatsSelfTest())
+        return false;
+
+    WorkPackage wp;
+    KeccakSearchJob job;
+    uint64_t found[count];
+    uint64_t list[count];
+    uint64_t passed[count / 64];
+    for (unsigned pattern = 0; pattern < 4; pattern++)
+    {
+        for (unsigned i = 0; i < wp.header.size; i++)
+            wp.header[i] = (byte)(pattern == 0 ? 0 : (pattern == 1 ? 0xff : i * 37 + pattern));
+
+        // About one nonce out of 16 is within boundary. Last pattern
+        // has the boundary cut in the lower 192 bits too
+        wp.boundary = h256();
+        for (unsigned i = 1; i < wp.boundary.size; i++)
+            wp.boundary[i] = (pattern == 3 && i == 8) ? 0x00 : 0xff;
+        wp.boundary[0] = 0x0f;
+        keccakSearchPrepare(job, wp);
+
+        for (auto nonce : nonces)
+            if (keccakSearchHash(job, nonce) != KeccakAux::eval(wp.header, nonce).value)
+                return false;
+
+        // Kernel must find exactly the nonces KeccakAux::eval accepts
+        const uint64_t start = nonces[pattern + 2] - count / 2 - 1;
+        unsigned n = _kernel.search(job, start, count, found, count);
+        unsigned expected = 0;
+        for (unsigned i = 0; i < count; i++)
+        {
+            if (KeccakAux::eval(wp.header, start + i).value > wp.boundary)
+                continue;
+            if (expected >= n || found[expected] != start + i)
+                return false;
+            expected++;
+        }
+        if (expected != n)
+            return false;
+
+        // Same nonces, in reverse order, through verification entry
+        for (unsigned i = 0; i < count; i++)
+            list[i] = start + count - 1 - i;
+        for (unsigned i = 0; i < count / 64; i++)
+            passed[i] = 0;
+        _kernel.verify(job, list, count, passed);
+        for (unsigned i = 0; i < count; i++)
+        {
+            const bool pass = (passed[i / 64] >> (i % 64)) & 1;
+            if (pass != (KeccakAux::eval(wp.header, list[i]).value <= wp.boundary))
+                return false;
+        }
+    }
+    return true;
+}
+
+bool cpuAlways()
+{
+    return true;
+}
+
+bool cpuHasSSE2()
+{
+#if KECCAK_CPU_X86 && (defined(__x86_64__) || defined(_M_X64))
+    return true;
+#elif KECCAK_CPU_X86 && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#elif KECCAK_CPU_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#else
+    return false;
+#endif
+}
+
+bool cpuHasAVX2()
+{
+#if KECCAK_CPU_X86 && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif KECCAK_CPU_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+bool cpuHasAVX512()
+{
+#if KECCAK_CPU_X86 && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    // OS must save opmask and both halves of zmm registers too
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 0xe6) != 0xe6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 16)) != 0;
+#elif KECCAK_CPU_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f");
+#else
+    return false;
+#endif
+}
+
+unsigned keccakSearchMultiBuffer2(KeccakSearchJob const& _job, uint64_t _startNonce,
+    unsigned _count, uint64_t* _found, unsigned _maxFound)
+{
+    return keccakSearchN<2>(_job, _startNonce, _count, _found, _maxFound);
+}
+
+unsigned keccakSearchMultiBuffer4(KeccakSearchJob const& _job, uint64_t _startNonce,
+    unsigned _count, uint64_t* _found, unsigned _maxFound)
+{
+    return keccakSearchN<4>(_job, _startNonce, _count, _found, _maxFound);
+}
+
+vector<KeccakSearchKernel> const& keccakSearchKernels()
+{
+    static const vector<KeccakSearchKernel> kernels = {
+        {"scalar", 1, keccakSearch, keccakVerify, cpuAlways, 0},
+        {"generic", 1, keccakSearchGeneric, keccakVerifyGeneric, cpuAlways, 0},
+        {"scalar-x2", 2, keccakSearchMultiBuffer2, keccakVerify, cpuAlways, 0},
+        {"scalar-x4", 4, keccakSearchMultiBuffer4, keccakVerify, cpuAlways, 0},
+#if KECCAK_CPU_X86
+        {"sse2", 2, keccakSearchSSE2, keccakVerifySSE2, cpuHasSSE2, 0},
+        {"avx2", 4, keccakSearchAVX2, keccakVerifyAVX2, cpuHasAVX2, 0},
+        {"avx512", 8, keccakSearchAVX512, keccakVerifyAVX512, cpuHasAVX512, 0},
+#endif
+    };
+    return kernels;
+}
+
+KeccakSearchKernel const& keccakSearchKernel()
+{
+    static const KeccakSearchKernel kernel = pickKernel();
+    return kernel;
+}
+
+unsigned keccakSearch(KeccakSearchJob const& _job, uint64_t _startNonce, unsigned _count,
+    uint64_t* _found, unsigned _maxFound)
+{
+    unsigned found = 0;
+    uint64_t state[25];
+
+    for (unsigned i = 0; i < _count; i++)
+    {
+        const uint64_t nonce = _startNonce + i;
+        keccakRound0(_job, nonce, state);
+        Rounds::permute<1, 1>(state);
+
+        // Early reject on upper 64 bits (lane 0 is all last round computed).
+        // Rare candidates get the full permutation and the exact 256 bit compare
+        if (bswap64(state[0]) > _job.target)
+            continue;
+        if (keccakSearchHash(_job, nonce) <= _job.boundary && found < _maxFound)
+            _found[found++] = nonce;
+    }
+
+    return found;
+}
+
+void keccakVerify(
+    KeccakSearchJob const& _job, const uint64_t* _nonces, unsigned _count, uint64_t* _passed)
+{
+    uint64_t state[25];
+
+    for (unsigned i = 0; i < _count; i++)
+    {
+        keccakRound0(_job, _nonces[i], state);
+        Rounds::permute<1, 1>(state);
+        if (bswap64(state[0]) > _job.target)
+            continue;
+        if (keccakSearchHash(_job, _nonces[i]) <= _job.boundary)
+            _passed[i / 64] |= 1ULL << (i % 64);
+    }
+}
+
+unsigned keccakSearchGeneric(KeccakSearchJob const& _job, uint64_t _startNonce, unsigned _count,
+    uint64_t* _found, unsigned _maxFound)
+{
+    return GenericHash::search(_job.format, _startNonce, _count, _found, _maxFound);
+}
+
+void keccakVerifyGeneric(
+    KeccakSearchJob const& _job, const uint64_t* _nonces, unsigned _count, uint64_t* _passed)
+{
+    for (unsigned i = 0; i < _count; i++)
+        if (GenericHash::upper(_job.format, _nonces[i]) <= _job.target &&
+            GenericHash::hash(_job.format, _nonces[i]) <= _job.boundary)
+            _passed[i / 64] |= 1ULL << (i % 64);
+}
+
+}  // namespace etc
+}  // namespace dev
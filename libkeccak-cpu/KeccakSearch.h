@@ -0,0 +1,196 @@
+/*
+This file is part of keccakminer.
+
+keccakminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+keccakminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <libkeccakcore/KeccakAux.h>
+#include <libkeccakcore/KeccakFormat.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define KECCAK_CPU_X86 1
+#endif
+
+// Per function code generation for SIMD kernels. Keeps the rest
+// of the binary runnable on any CPU of the architecture
+#if defined(__GNUC__) || defined(__clang__)
+#define KECCAK_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KECCAK_TARGET(isa)
+#endif
+
+namespace dev
+{
+namespace etc
+{
+/**
+ * @brief Message format hashed by the native kernels below. Their round 0
+ * midstate is written for a single block with the header in lanes 0..3 and
+ * the nonce in lane 4 : only the padding byte may change. Other formats
+ * use KeccakFormatHash, as the generic kernel does
+ */
+typedef Keccak256Format KeccakSearchFormat;
+static_assert(KeccakSearchFormat::headerBytes == 32 && KeccakSearchFormat::nonceOffset == 32 &&
+                  KeccakSearchFormat::nonceBigEndian,
+    "Native search kernels only handle a 32 bytes header followed by a big-endian nonce");
+
+/**
+ * @brief Job constants of the 40 bytes header||nonce message hashed by CPU miners.
+ * Built once per WorkPackage, it needs no epoch context nor any DAG.
+ * Also holds the midstate: all of Keccak round 0 which does not depend on the nonce.
+ */
+struct KeccakSearchJob
+{
+    uint64_t header[4];  // Header hash loaded as little-endian Keccak lanes
+    h256 boundary;       // Full 256 bit boundary the digest must not exceed
+    uint64_t target;     // Upper 64 bits of boundary
+
+    uint64_t theta0;     // Nonce independent part of round 0 theta D[0]
+    uint64_t theta4;     // Round 0 theta D[4]
+    uint64_t rhoPi[25];  // Round 0 rho/pi output of the lanes not depending on the nonce
+    uint64_t chi[25];    // Round 0 chi terms made of constant lanes only (iota folded in [0])
+
+    KeccakFormatJob<KeccakSearchFormat> format;  // Same job for the generic kernel
+};
+
+/**
+ * @brief Fills job constants out of a work package
+ */
+void keccakSearchPrepare(KeccakSearchJob& _job, WorkPackage const& _wp);
+
+/**
+ * @brief Computes the digest of a single nonce. Same result as KeccakAux::eval
+ */
+h256 keccakSearchHash(KeccakSearchJob const& _job, uint64_t _nonce);
+
+/**
+ * @brief Search kernel signature.
+ * Hashes _count consecutive nonces starting from _startNonce
+ * @return The number of nonces, stored in _found, whose digest is within job's boundary
+ */
+typedef unsigned (*KeccakSearchFn)(KeccakSearchJob const& _job, uint64_t _startNonce,
+    unsigned _count, uint64_t* _found, unsigned _maxFound);
+
+/**
+ * @brief Verification kernel signature.
+ * Hashes _count arbitrary nonces and sets bit i of _passed (which is
+ * not cleared beforehand) when digest of _nonces[i] is within job's boundary
+ */
+typedef void (*KeccakVerifyFn)(
+    KeccakSearchJob const& _job, const uint64_t* _nonces, unsigned _count, uint64_t* _passed);
+
+struct KeccakSearchKernel
+{
+    const char* name;      // Short name for logs
+    unsigned lanes;        // Nonces hashed in parallel
+    KeccakSearchFn search;  // Entry point for consecutive nonces
+    KeccakVerifyFn verify;  // Entry point for a list of nonces
+    bool (*supported)();   // Whether or not this host can run it
+    double hashRate;       // Single thread hashes per second as benchmarked at startup
+};
+
+/**
+ * @brief Plain scalar kernel. Runs everywhere
+ */
+unsigned keccakSearch(KeccakSearchJob const& _job, uint64_t _startNonce, unsigned _count,
+    uint64_t* _found, unsigned _maxFound);
+void keccakVerify(
+    KeccakSearchJob const& _job, const uint64_t* _nonces, unsigned _count, uint64_t* _passed);
+
+/**
+ * @brief Kernel built from KeccakFormatHash<KeccakSearchFormat>. Runs
+ * everywhere and is the reference for formats native kernels can't hash
+ */
+unsigned keccakSearchGeneric(KeccakSearchJob const& _job, uint64_t _startNonce, unsigned _count,
+    uint64_t* _found, unsigned _maxFound);
+void keccakVerifyGeneric(
+    KeccakSearchJob const& _job, const uint64_t* _nonces, unsigned _count, uint64_t* _passed);
+
+/**
+ * @brief Multi-buffer scalar kernels : 2 or 4 independent states
+ * interleaved by a single thread. Run everywhere
+ */
+unsigned keccakSearchMultiBuffer2(KeccakSearchJob const& _job, uint64_t _startNonce,
+    unsigned _count, uint64_t* _found, unsigned _maxFound);
+unsigned keccakSearchMultiBuffer4(KeccakSearchJob const& _job, uint64_t _startNonce,
+    unsigned _count, uint64_t* _found, unsigned _maxFound);
+
+#if KECCAK_CPU_X86
+/**
+ * @brief 2-way interleaved kernel. Host must support SSE2
+ */
+unsigned keccakSearchSSE2(KeccakSearchJob const& _job, uint64_t _startNonce, unsigned _count,
+    uint64_t* _found, unsigned _maxFound);
+void keccakVerifySSE2(
+    KeccakSearchJob const& _job, const uint64_t* _nonces, unsigned _count, uint64_t* _passed);
+
+/**
+ * @brief 4-way interleaved kernel. Host must support AVX2
+ */
+unsigned keccakSearchAVX2(KeccakSearchJob const& _job, uint64_t _startNonce, unsigned _count,
+    uint64_t* _found, unsigned _maxFound);
+void keccakVerifyAVX2(
+    KeccakSearchJob const& _job, const uint64_t* _nonces, unsigned _count, uint64_t* _passed);
+
+/**
+ * @brief 8-way interleaved kernel. Host must support AVX-512F
+ */
+unsigned keccakSearchAVX512(KeccakSearchJob const& _job, uint64_t _startNonce, unsigned _count,
+    uint64_t* _found, unsigned _maxFound);
+void keccakVerifyAVX512(
+    KeccakSearchJob const& _job, const uint64_t* _nonces, unsigned _count, uint64_t* _passed);
+#endif
+
+/**
+ * @brief Whether or not this host can run SSE2 code
+ */
+bool cpuHasSSE2();
+
+/**
+ * @brief Whether or not this host can run AVX2 code
+ */
+bool cpuHasAVX2();
+
+/**
+ * @brief Whether or not this host can run AVX-512F code
+ */
+bool cpuHasAVX512();
+
+/**
+ * @brief Registry of all kernels built in this binary. Scalar one comes first
+ */
+std::vector<KeccakSearchKernel> const& keccakSearchKernels();
+
+/**
+ * @brief Fastest kernel on this host.
+ * First call discards kernels cpuid says this host can't run or failing
+ * the self test, then benchmarks the others for about 200 ms overall
+ * @threadsafe
+ */
+KeccakSearchKernel const& keccakSearchKernel();
+
+/**
+ * @brief Checks keccakSearchHash and the given kernel against KeccakAux::eval
+ * on a set of known inputs, and a few non default message formats against
+ * reference SHA3-256 digests
+ * @return false if any digest, any found nonce or any verified nonce differs
+ */
+bool keccakSearchSelfTest(KeccakSearchKernel const& _kernel);
+
+}  // namespace etc
+}  // namespace dev
@@ -0,0 +1,275 @@
+/*
+This file is part of keccakminer.
+
+keccakminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+keccakminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ AVX2 Keccak-256 search : 4 consecutive nonces are hashed at once,
+ one per 64 bit lane of each __m256i (i.e. state is interleaved).
+ Only functions marked KECCAK_TARGET("avx2") get AVX2 code generation
+ thus keccakSearchAVX2 must only be entered after cpuHasAVX2() said so.
+*/
+
+#include "KeccakSearch.h"
+
+#include <libkeccakcore/KeccakRounds.h>
+
+#if KECCAK_CPU_X86
+
+#include <immintrin.h>
+
+using namespace std;
+using namespace dev;
+using namespace etc;
+
+namespace
+{
+#define XOR(a, b) _mm256_xor_si256(a, b)
+#define ANDN(a, b) _mm256_andnot_si256(a, b)  // ~a & b
+#define ROTL(x, n) _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - (n)))
+#define SET1(x) _mm256_set1_epi64x((long long)(x))
+
+// Byte swap of each 64 bit lane
+KECCAK_TARGET("avx2") inline __m256i bswap(__m256i _x)
+{
+    const __m256i mask = _mm256_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7, 8,
+        9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+    return _mm256_shuffle_epi8(_x, mask);
+}
+
+KECCAK_TARGET("avx2") inline void keccakf1600Round(__m256i* a, unsigned r)
+{
+    // theta
+    const __m256i c0 = XOR(XOR(XOR(XOR(a[0], a[5]), a[10]), a[15]), a[20]);
+    const __m256i c1 = XOR(XOR(XOR(XOR(a[1], a[6]), a[11]), a[16]), a[21]);
+    const __m256i c2 = XOR(XOR(XOR(XOR(a[2], a[7]), a[12]), a[17]), a[22]);
+    const __m256i c3 = XOR(XOR(XOR(XOR(a[3], a[8]), a[13]), a[18]), a[23]);
+    const __m256i c4 = XOR(XOR(XOR(XOR(a[4], a[9]), a[14]), a[19]), a[24]);
+
+    const __m256i d0 = XOR(c4, ROTL(c1, 1));
+    const __m256i d1 = XOR(c0, ROTL(c2, 1));
+    const __m256i d2 = XOR(c1, ROTL(c3, 1));
+    const __m256i d3 = XOR(c2, ROTL(c4, 1));
+    const __m256i d4 = XOR(c3, ROTL(c0, 1));
+
+    for (unsigned y = 0; y < 25; y += 5)
+    {
+        a[y] = XOR(a[y], d0);
+        a[y + 1] = XOR(a[y + 1], d1);
+        a[y + 2] = XOR(a[y + 2], d2);
+        a[y + 3] = XOR(a[y + 3], d3);
+        a[y + 4] = XOR(a[y + 4], d4);
+    }
+
+    // rho pi
+    const __m256i u = a[1];
+    a[1] = ROTL(a[6], 44);
+    a[6] = ROTL(a[9], 20);
+    a[9] = ROTL(a[22], 61);
+    a[22] = ROTL(a[14], 39);
+    a[14] = ROTL(a[20], 18);
+    a[20] = ROTL(a[2], 62);
+    a[2] = ROTL(a[12], 43);
+    a[12] = ROTL(a[13], 25);
+    a[13] = ROTL(a[19], 8);
+    a[19] = ROTL(a[23], 56);
+    a[23] = ROTL(a[15], 41);
+    a[15] = ROTL(a[4], 27);
+    a[4] = ROTL(a[24], 14);
+    a[24] = ROTL(a[21], 2);
+    a[21] = ROTL(a[8], 55);
+    a[8] = ROTL(a[16], 45);
+    a[16] = ROTL(a[5], 36);
+    a[5] = ROTL(a[3], 28);
+    a[3] = ROTL(a[18], 21);
+    a[18] = ROTL(a[17], 15);
+    a[17] = ROTL(a[11], 10);
+    a[11] = ROTL(a[7], 6);
+    a[7] = ROTL(a[10], 3);
+    a[10] = ROTL(u, 1);
+
+    // chi
+    for (unsigned y = 0; y < 25; y += 5)
+    {
+        const __m256i v0 = a[y];
+        const __m256i v1 = a[y + 1];
+        a[y] = XOR(a[y], ANDN(v1, a[y + 2]));
+        a[y + 1] = XOR(a[y + 1], ANDN(a[y + 2], a[y + 3]));
+        a[y + 2] = XOR(a[y + 2], ANDN(a[y + 3], a[y + 4]));
+        a[y + 3] = XOR(a[y + 3], ANDN(a[y + 4], v0));
+        a[y + 4] = XOR(a[y + 4], ANDN(v0, v1));
+    }
+
+    // iota
+    a[0] = XOR(a[0], SET1(KeccakF1600Spec::rc[r]));
+}
+
+// Last round computing output lane 0 only : theta of the three lanes chi
+// reads for it, then chi and iota. See KeccakRounds<>::round<Live, 1>
+KECCAK_TARGET("avx2") inline __m256i keccakf1600Round23Lane0(const __m256i* a)
+{
+    const __m256i c0 = XOR(XOR(XOR(XOR(a[0], a[5]), a[10]), a[15]), a[20]);
+    const __m256i c1 = XOR(XOR(XOR(XOR(a[1], a[6]), a[11]), a[16]), a[21]);
+    const __m256i c2 = XOR(XOR(XOR(XOR(a[2], a[7]), a[12]), a[17]), a[22]);
+    const __m256i c3 = XOR(XOR(XOR(XOR(a[3], a[8]), a[13]), a[18]), a[23]);
+    const __m256i c4 = XOR(XOR(XOR(XOR(a[4], a[9]), a[14]), a[19]), a[24]);
+
+    const __m256i b0 = XOR(XOR(a[0], c4), ROTL(c1, 1));
+    const __m256i b1 = ROTL(XOR(XOR(a[6], c0), ROTL(c2, 1)), 44);
+    const __m256i b2 = ROTL(XOR(XOR(a[12], c1), ROTL(c3, 1)), 43);
+
+    return XOR(XOR(b0, ANDN(b1, b2)), SET1(KeccakF1600Spec::rc[23]));
+}
+
+// Round 0 out of the job's midstate. See keccakRound0 in KeccakSearch.cpp
+KECCAK_TARGET("avx2") inline void keccakRound0(
+    KeccakSearchJob const& _job, __m256i _nonces, __m256i* a)
+{
+    const uint64_t* b = _job.rhoPi;
+    const __m256i n = bswap(_nonces);
+    const __m256i d0 = XOR(n, SET1(_job.theta0));
+    const __m256i d3 = XOR(SET1(_job.header[2]), ROTL(n, 1));
+
+    const __m256i b0 = XOR(SET1(_job.header[0]), d0);
+    const __m256i b3 = ROTL(d3, 21);
+    const __m256i b5 = ROTL(XOR(SET1(_job.header[3]), d3), 28);
+    const __m256i b7 = ROTL(d0, 3);
+    const __m256i b12 = ROTL(d3, 25);
+    const __m256i b14 = ROTL(d0, 18);
+    const __m256i b15 = ROTL(XOR(n, SET1(_job.theta4)), 27);
+    const __m256i b16 = ROTL(XOR(d0, SET1(KeccakSearchFormat::pad)), 36);
+    const __m256i b19 = ROTL(d3, 56);
+    const __m256i b21 = ROTL(d3, 55);
+    const __m256i b23 = ROTL(d0, 41);
+
+    a[0] = XOR(b0, SET1(_job.chi[0]));
+    a[1] = XOR(SET1(b[1]), _mm256_and_si256(SET1(~b[2]), b3));
+    a[2] = XOR(SET1(b[2]), ANDN(b3, SET1(b[4])));
+    a[3] = XOR(b3, _mm256_and_si256(SET1(~b[4]), b0));
+    a[4] = XOR(SET1(b[4]), ANDN(b0, SET1(b[1])));
+
+    a[5] = XOR(b5, _mm256_and_si256(SET1(~b[6]), b7));
+    a[6] = XOR(SET1(b[6]), ANDN(b7, SET1(b[8])));
+    a[7] = XOR(b7, SET1(_job.chi[7]));
+    a[8] = XOR(SET1(b[8]), _mm256_and_si256(SET1(~b[9]), b5));
+    a[9] = XOR(SET1(b[9]), ANDN(b5, SET1(b[6])));
+
+    a[10] = XOR(SET1(b[10]), _mm256_and_si256(SET1(~b[11]), b12));
+    a[11] = XOR(SET1(b[11]), ANDN(b12, SET1(b[13])));
+    a[12] = XOR(b12, _mm256_and_si256(SET1(~b[13]), b14));
+    a[13] = XOR(SET1(b[13]), ANDN(b14, SET1(b[10])));
+    a[14] = XOR(b14, SET1(_job.chi[14]));
+
+    a[15] = XOR(b15, ANDN(b16, SET1(b[17])));
+    a[16] = XOR(b16, SET1(_job.chi[16]));
+    a[17] = XOR(SET1(b[17]), _mm256_and_si256(SET1(~b[18]), b19));
+    a[18] = XOR(SET1(b[18]), ANDN(b19, b15));
+    a[19] = XOR(b19, ANDN(b15, b16));
+
+    a[20] = XOR(SET1(b[20]), ANDN(b21, SET1(b[22])));
+    a[21] = XOR(b21, _mm256_and_si256(SET1(~b[22]), b23));
+    a[22] = XOR(SET1(b[22]), ANDN(b23, SET1(b[24])));
+    a[23] = XOR(b23, SET1(_job.chi[23]));
+    a[24] = XOR(SET1(b[24]), _mm256_and_si256(SET1(~b[20]), b21));
+}
+
+// Upper 64 bits of the digests of a vector of nonces
+KECCAK_TARGET("avx2") inline __m256i keccakHashUpper(KeccakSearchJob const& _job, __m256i _nonces)
+{
+    __m256i state[25];
+    keccakRound0(_job, _nonces, state);
+    for (unsigned r = 1; r < 23; r++)
+        keccakf1600Round(state, r);
+    return bswap(keccakf1600Round23Lane0(state));
+}
+
+}  // namespace
+
+namespace dev
+{
+namespace etc
+{
+KECCAK_TARGET("avx2")
+unsigned keccakSearchAVX2(KeccakSearchJob const& _job, uint64_t _startNonce, unsigned _count,
+    uint64_t* _found, unsigned _maxFound)
+{
+    // Unsigned 64 bit compare through signed one : flip sign bits
+    const __m256i sign = SET1(0x8000000000000000ULL);
+    const __m256i target = XOR(SET1(_job.target), sign);
+    const __m256i step = SET1(4);
+
+    unsigned found = 0;
+    unsigned i = 0;
+    __m256i nonces = _mm256_add_epi64(SET1(_startNonce), _mm256_set_epi64x(3, 2, 1, 0));
+
+    for (; i + 4 <= _count; i += 4, nonces = _mm256_add_epi64(nonces, step))
+    {
+        // Prefilter on upper 64 bits of the digest. Candidates are
+        // then checked against the full boundary.
+        const __m256i upper = XOR(keccakHashUpper(_job, nonces), sign);
+        const int above =
+            _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(upper, target)));
+        if (above == 0xf)
+            continue;
+
+        for (unsigned l = 0; l < 4; l++)
+        {
+            if (above & (1 << l))
+                continue;
+            const uint64_t nonce = _startNonce + i + l;
+            if (keccakSearchHash(_job, nonce) <= _job.boundary && found < _maxFound)
+                _found[found++] = nonce;
+        }
+    }
+
+    // Leftovers
+    if (i < _count)
+        found += keccakSearch(_job, _startNonce + i, _count - i, _found + found, _maxFound - found);
+
+    return found;
+}
+
+KECCAK_TARGET("avx2")
+void keccakVerifyAVX2(
+    KeccakSearchJob const& _job, const uint64_t* _nonces, unsigned _count, uint64_t* _passed)
+{
+    const __m256i sign = SET1(0x8000000000000000ULL);
+    const __m256i target = XOR(SET1(_job.target), sign);
+
+    unsigned i = 0;
+    for (; i + 4 <= _count; i += 4)
+    {
+        const __m256i nonces = _mm256_loadu_si256((const __m256i*)(_nonces + i));
+        const __m256i upper = XOR(keccakHashUpper(_job, nonces), sign);
+        const int above =
+            _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(upper, target)));
+        if (above == 0xf)
+            continue;
+
+        for (unsigned l = 0; l < 4; l++)
+            if (!(above & (1 << l)) && keccakSearchHash(_job, _nonces[i + l]) <= _job.boundary)
+                _passed[(i + l) / 64] |= 1ULL << ((i + l) % 64);
+    }
+
+    // Leftovers
+    for (; i < _count; i++)
+        if (keccakSearchHash(_job, _nonces[i]) <= _job.boundary)
+            _passed[i / 64] |= 1ULL << (i % 64);
+}
+
+}  // namespace etc
+}  // namespace dev
+
+#endif
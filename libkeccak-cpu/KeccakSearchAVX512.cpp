@@ -0,0 +1,292 @@
+/*
+This file is part of keccakminer.
+
+keccakminer is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+keccakminer is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ AVX-512 Keccak-256 search : 8 consecutive nonces are hashed at once,
+ one per 64 bit lane of each __m512i. Mirrors keccak.cuh of the CUDA
+ backend : vpternlogq plays lop3.b32 (xor5, xor3, chi) and vprolq does
+ rho rotations in a single instruction. Only AVX-512F is required.
+ keccakSearchAVX512 must only be entered after cpuHasAVX512() said so.
+*/
+
+#include "KeccakSearch.h"
+
+#include <libkeccakcore/KeccakRounds.h>
+
+#if KECCAK_CPU_X86
+
+// Some GCC releases warn about the undefined pass-through operand their
+// own headers give to AVX-512 rotations. Silenced for the header's code
+// only : warnings about this file's code still show
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+using namespace std;
+using namespace dev;
+using namespace etc;
+
+namespace
+{
+#define XOR(a, b) _mm512_xor_si512(a, b)
+#define ROTL(x, n) _mm512_rol_epi64(x, n)
+#define SET1(x) _mm512_set1_epi64((long long)(x))
+
+KECCAK_TARGET("avx512f") inline __m512i xor3(__m512i a, __m512i b, __m512i c)
+{
+    return _mm512_ternarylogic_epi64(a, b, c, 0x96);
+}
+
+KECCAK_TARGET("avx512f") inline __m512i xor5(
+    __m512i a, __m512i b, __m512i c, __m512i d, __m512i e)
+{
+    return xor3(xor3(a, b, c), d, e);
+}
+
+// a ^ (~b & c)
+KECCAK_TARGET("avx512f") inline __m512i chi(__m512i a, __m512i b, __m512i c)
+{
+    return _mm512_ternarylogic_epi64(a, b, c, 0xD2);
+}
+
+// Byte swap of each 64 bit lane without AVX-512BW : swap dwords
+// then bytes within dwords picking either rotation of each dword
+KECCAK_TARGET("avx512f") inline __m512i bswap(__m512i _x)
+{
+    const __m512i x = ROTL(_x, 32);
+    return _mm512_ternarylogic_epi64(_mm512_rol_epi32(x, 8), _mm512_ror_epi32(x, 8),
+        _mm512_set1_epi32(0x00ff00ff), 0xE4);
+}
+
+KECCAK_TARGET("avx512f") inline void keccakf1600Round(__m512i* a, unsigned r)
+{
+    // theta
+    const __m512i c0 = xor5(a[0], a[5], a[10], a[15], a[20]);
+    const __m512i c1 = xor5(a[1], a[6], a[11], a[16], a[21]);
+    const __m512i c2 = xor5(a[2], a[7], a[12], a[17], a[22]);
+    const __m512i c3 = xor5(a[3], a[8], a[13], a[18], a[23]);
+    const __m512i c4 = xor5(a[4], a[9], a[14], a[19], a[24]);
+
+    const __m512i d0 = XOR(c4, ROTL(c1, 1));
+    const __m512i d1 = XOR(c0, ROTL(c2, 1));
+    const __m512i d2 = XOR(c1, ROTL(c3, 1));
+    const __m512i d3 = XOR(c2, ROTL(c4, 1));
+    const __m512i d4 = XOR(c3, ROTL(c0, 1));
+
+    for (unsigned y = 0; y < 25; y += 5)
+    {
+        a[y] = XOR(a[y], d0);
+        a[y + 1] = XOR(a[y + 1], d1);
+        a[y + 2] = XOR(a[y + 2], d2);
+        a[y + 3] = XOR(a[y + 3], d3);
+        a[y + 4] = XOR(a[y + 4], d4);
+    }
+
+    // rho pi
+    const __m512i u = a[1];
+    a[1] = ROTL(a[6], 44);
+    a[6] = ROTL(a[9], 20);
+    a[9] = ROTL(a[22], 61);
+    a[22] = ROTL(a[14], 39);
+    a[14] = ROTL(a[20], 18);
+    a[20] = ROTL(a[2], 62);
+    a[2] = ROTL(a[12], 43);
+    a[12] = ROTL(a[13], 25);
+    a[13] = ROTL(a[19], 8);
+    a[19] = ROTL(a[23], 56);
+    a[23] = ROTL(a[15], 41);
+    a[15] = ROTL(a[4], 27);
+    a[4] = ROTL(a[24], 14);
+    a[24] = ROTL(a[21], 2);
+    a[21] = ROTL(a[8], 55);
+    a[8] = ROTL(a[16], 45);
+    a[16] = ROTL(a[5], 36);
+    a[5] = ROTL(a[3], 28);
+    a[3] = ROTL(a[18], 21);
+    a[18] = ROTL(a[17], 15);
+    a[17] = ROTL(a[11], 10);
+    a[11] = ROTL(a[7], 6);
+    a[7] = ROTL(a[10], 3);
+    a[10] = ROTL(u, 1);
+
+    // chi
+    for (unsigned y = 0; y < 25; y += 5)
+    {
+        const __m512i v0 = a[y];
+        const __m512i v1 = a[y + 1];
+        a[y] = chi(a[y], v1, a[y + 2]);
+        a[y + 1] = chi(a[y + 1], a[y + 2], a[y + 3]);
+        a[y + 2] = chi(a[y + 2], a[y + 3], a[y + 4]);
+        a[y + 3] = chi(a[y + 3], a[y + 4], v0);
+        a[y + 4] = chi(a[y + 4], v0, v1);
+    }
+
+    // iota
+    a[0] = XOR(a[0], SET1(KeccakF1600Spec::rc[r]));
+}
+
+// Last round computing output lane 0 only : theta of the three lanes chi
+// reads for it, then chi and iota. See KeccakRounds<>::round<Live, 1>
+KECCAK_TARGET("avx512f") inline __m512i keccakf1600Round23Lane0(const __m512i* a)
+{
+    const __m512i c0 = xor5(a[0], a[5], a[10], a[15], a[20]);
+    const __m512i c1 = xor5(a[1], a[6], a[11], a[16], a[21]);
+    const __m512i c2 = xor5(a[2], a[7], a[12], a[17], a[22]);
+    const __m512i c3 = xor5(a[3], a[8], a[13], a[18], a[23]);
+    const __m512i c4 = xor5(a[4], a[9], a[14], a[19], a[24]);
+
+    const __m512i b0 = xor3(a[0], c4, ROTL(c1, 1));
+    const __m512i b1 = ROTL(xor3(a[6], c0, ROTL(c2, 1)), 44);
+    const __m512i b2 = ROTL(xor3(a[12], c1, ROTL(c3, 1)), 43);
+
+    return XOR(chi(b0, b1, b2), SET1(KeccakF1600Spec::rc[23]));
+}
+
+// Round 0 out of the job's midstate. See keccakRound0 in KeccakSearch.cpp
+KECCAK_TARGET("avx512f") inline void keccakRound0(
+    KeccakSearchJob const& _job, __m512i _nonces, __m512i* a)
+{
+    const uint64_t* b = _job.rhoPi;
+    const __m512i n = bswap(_nonces);
+    const __m512i d0 = XOR(n, SET1(_job.theta0));
+    const __m512i d3 = XOR(SET1(_job.header[2]), ROTL(n, 1));
+
+    const __m512i b0 = XOR(SET1(_job.header[0]), d0);
+    const __m512i b3 = ROTL(d3, 21);
+    const __m512i b5 = ROTL(XOR(SET1(_job.header[3]), d3), 28);
+    const __m512i b7 = ROTL(d0, 3);
+    const __m512i b12 = ROTL(d3, 25);
+    const __m512i b14 = ROTL(d0, 18);
+    const __m512i b15 = ROTL(XOR(n, SET1(_job.theta4)), 27);
+    const __m512i b16 = ROTL(XOR(d0, SET1(KeccakSearchFormat::pad)), 36);
+    const __m512i b19 = ROTL(d3, 56);
+    const __m512i b21 = ROTL(d3, 55);
+    const __m512i b23 = ROTL(d0, 41);
+
+    a[0] = XOR(b0, SET1(_job.chi[0]));
+    a[1] = chi(SET1(b[1]), SET1(b[2]), b3);
+    a[2] = chi(SET1(b[2]), b3, SET1(b[4]));
+    a[3] = chi(b3, SET1(b[4]), b0);
+    a[4] = chi(SET1(b[4]), b0, SET1(b[1]));
+
+    a[5] = chi(b5, SET1(b[6]), b7);
+    a[6] = chi(SET1(b[6]), b7, SET1(b[8]));
+    a[7] = XOR(b7, SET1(_job.chi[7]));
+    a[8] = chi(SET1(b[8]), SET1(b[9]), b5);
+    a[9] = chi(SET1(b[9]), b5, SET1(b[6]));
+
+    a[10] = chi(SET1(b[10]), SET1(b[11]), b12);
+    a[11] = chi(SET1(b[11]), b12, SET1(b[13]));
+    a[12] = chi(b12, SET1(b[13]), b14);
+    a[13] = chi(SET1(b[13]), b14, SET1(b[10]));
+    a[14] = XOR(b14, SET1(_job.chi[14]));
+
+    a[15] = chi(b15, b16, SET1(b[17]));
+    a[16] = XOR(b16, SET1(_job.chi[16]));
+    a[17] = chi(SET1(b[17]), SET1(b[18]), b19);
+    a[18] = chi(SET1(b[18]), b19, b15);
+    a[19] = chi(b19, b15, b16);
+
+    a[20] = chi(SET1(b[20]), b21, SET1(b[22]));
+    a[21] = chi(b21, SET1(b[22]), b23);
+    a[22] = chi(SET1(b[22]), b23, SET1(b[24]));
+    a[23] = XOR(b23, SET1(_job.chi[23]));
+    a[24] = chi(SET1(b[24]), SET1(b[20]), b21);
+}
+
+// Upper 64 bits of the digests of a vector of nonces
+KECCAK_TARGET("avx512f") inline __m512i keccakHashUpper(KeccakSearchJob const& _job, __m512i _nonces)
+{
+    __m512i state[25];
+    keccakRound0(_job, _nonces, state);
+    for (unsigned r = 1; r < 23; r++)
+        keccakf1600Round(state, r);
+    return bswap(keccakf1600Round23Lane0(state));
+}
+
+}  // namespace
+
+namespace dev
+{
+namespace etc
+{
+KECCAK_TARGET("avx512f")
+unsigned keccakSearchAVX512(KeccakSearchJob const& _job, uint64_t _startNonce, unsigned _count,
+    uint64_t* _found, unsigned _maxFound)
+{
+    const __m512i target = SET1(_job.target);
+    const __m512i step = SET1(8);
+
+    unsigned found = 0;
+    unsigned i = 0;
+    __m512i nonces =
+        _mm512_add_epi64(SET1(_startNonce), _mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0));
+
+    for (; i + 8 <= _count; i += 8, nonces = _mm512_add_epi64(nonces, step))
+    {
+        // Prefilter on upper 64 bits of the digest. Candidates are
+        // then checked against the full boundary.
+        __mmask8 candidates = _mm512_cmple_epu64_mask(keccakHashUpper(_job, nonces), target);
+        for (unsigned l = 0; candidates; l++, candidates >>= 1)
+        {
+            if (!(candidates & 1))
+                continue;
+            const uint64_t nonce = _startNonce + i + l;
+            if (keccakSearchHash(_job, nonce) <= _job.boundary && found < _maxFound)
+                _found[found++] = nonce;
+        }
+    }
+
+    // Leftovers
+    if (i < _count)
+        found += keccakSearch(_job, _startNonce + i, _count - i, _found + found, _maxFound - found);
+
+    return found;
+}
+
+KECCAK_TARGET("avx512f")
+void keccakVerifyAVX512(
+    KeccakSearchJob const& _job, const uint64_t* _nonces, unsigned _count, uint64_t* _passed)
+{
+    const __m512i target = SET1(_job.target);
+
+    unsigned i = 0;
+    for (; i + 8 <= _count; i += 8)
+    {
+        const __m512i nonces = _mm512_loadu_si512((const void*)(_nonces + i));
+        __mmask8 candidates = _mm512_cmple_epu64_mask(keccakHashUpper(_job, nonces), target);
+        for (unsigned l = 0; candidates; l++, candidates >>= 1)
+            if ((candidates & 1) && keccakSearchHash(_job, _nonces[i + l]) <= _job.boundary)
+                _passed[(i + l) / 64] |= 1ULL << ((i + l) % 64);
+    }
+
+    // Leftovers
+    for (; i < _count; i++)
+        if (keccakSearchHash(_job, _nonces[i]) <= _job.boundary)
+            _passed[i / 64] |= 1ULL << (i % 64);
+}
+
+}  // namespace etc
+}  // namespace dev
+
+#endif
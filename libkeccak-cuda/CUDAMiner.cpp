@@ -200,14 +200,11 @@ void CUDAMiner::workLoop()
     {
         while (!shouldStop())
         {
-            // Wait for work or 3 seconds (whichever the first)
-            const WorkPackage w = work();
+            // Wait for work, resume or 3 seconds (whichever the first)
+            WorkPackage const& w = work();
             if (!w)
             {
-                boost::system_time const timeout =
-                    boost::get_system_time() + boost::posix_time::seconds(3);
-                boost::mutex::scoped_lock l(x_work);
-                m_new_work_signal.timed_wait(l, timeout);
+                waitForWork();
                 continue;
             }
 
@@ -246,7 +243,11 @@ void CUDAMiner::workLoop()
 
 void CUDAMiner::kick_miner()
 {
-    m_new_work.store(true, std::memory_order_relaxed);
+    {
+        // Under the lock waiters sleep with, so the wakeup can't be missed
+        boost::mutex::scoped_lock l(x_work);
+        m_new_work.store(true, std::memory_order_relaxed);
+    }
     m_new_work_signal.notify_one();
 }
 
@@ -412,8 +413,8 @@ void CUDAMiner::search(
                 {
                     uint64_t nonce = nonce_base + gids[i];
 
-                    Farm::f().submitProof(
-                        Solution{nonce, mixes[i], w, std::chrono::steady_clock::now(), m_index});
+                    Farm::f().submitProof(Solution{
+                        nonce, mixes[i], workJob(), std::chrono::steady_clock::now(), m_index});
                     cudalog << EthWhite << "Job: " << w.header.abridged() << " Sol: 0x"
                             << toHex(nonce) << EthReset;
                 }
@@ -17,6 +17,7 @@
 
 
 #include <libkeccakcore/Farm.h>
+#include <libkeccakcore/SelfTest.h>
 
 #if ETC_KECCAKCL
 #include <libkeccak-cl/CLMiner.h>
@@ -36,12 +37,22 @@ namespace etc
 {
 Farm* Farm::m_this = nullptr;
 
+namespace
+{
+const unsigned c_verifyThreads = 2;
+
+// Least time between two writes of the nonce ledger file while mining
+const std::chrono::seconds c_ledgerSaveInterval(60);
+}
+
 Farm::Farm(std::map<std::string, DeviceDescriptor>& _DevicesCollection,
     FarmSettings _settings, CUSettings _CUSettings, CLSettings _CLSettings, CPSettings _CPSettings)
   : m_Settings(std::move(_settings)),
     m_CUSettings(std::move(_CUSettings)),
     m_CLSettings(std::move(_CLSettings)),
     m_CPSettings(std::move(_CPSettings)),
+    m_history(TelemetryHistory::parse(m_Settings.telemetryHistory)),
+    m_historyTimer(g_io_service),
     m_io_strand(g_io_service),
     m_collectTimer(g_io_service),
     m_DevicesCollection(_DevicesCollection)
@@ -50,6 +61,11 @@ Farm::Farm(std::map<std::string, DeviceDescriptor>& _DevicesCollection,
 
     m_this = this;
 
+    // Bookkeeping all miners rely on. Failing it, mining goes on but
+    // nonces may be scanned twice or shares lost
+    if (char const* failed = farmSelfTest())
+        cwarn << "Self test of " << failed << " failed";
+
     // Init HWMON if needed
     if (m_Settings.hwMon)
     {
@@ -149,6 +165,21 @@ Farm::Farm(std::map<std::string, DeviceDescriptor>& _DevicesCollection,
     // Initialize nonce_scrambler
     shuffle();
 
+    // Coverage persisted by a previous run. Only read once : it is matched
+    // against incoming jobs in memory
+    if (!m_Settings.nonceLedger.empty())
+        m_savedLedger = NonceLedger::load(m_Settings.nonceLedger);
+
+    // Device changes block till miners leave their device : they get
+    // their own thread so the io strand goes on
+    m_deviceWork.reset(new boost::asio::io_service::work(m_deviceService));
+    m_deviceThread = std::thread([this]() { m_deviceService.run(); });
+
+    // Start share verifiers
+    if (!m_Settings.noEval)
+        for (unsigned i = 0; i < c_verifyThreads; i++)
+            m_verifiers.emplace_back(&Farm::verifyLoop, this);
+
     // Start data collector timer
     // It should work for the whole lifetime of Farm
     // regardless it's mining state
@@ -156,6 +187,14 @@ Farm::Farm(std::map<std::string, DeviceDescriptor>& _DevicesCollection,
     m_collectTimer.async_wait(
         m_io_strand.wrap(boost::bind(&Farm::collectData, this, boost::asio::placeholders::error)));
 
+    // Start history recorder, same lifetime
+    if (m_history.resolution())
+    {
+        m_historyTimer.expires_from_now(boost::posix_time::seconds(m_history.resolution()));
+        m_historyTimer.async_wait(m_io_strand.wrap(
+            boost::bind(&Farm::recordHistory, this, boost::asio::placeholders::error)));
+    }
+
     DEV_BUILD_LOG_PROGRAMFLOW(cnote, "Farm::Farm() end");
 }
 
@@ -165,6 +204,7 @@ Farm::~Farm()
 
     // Stop data collector (before monitors !!!)
     m_collectTimer.cancel();
+    m_historyTimer.cancel();
 
     // Deinit HWMON
 #if defined(__linux)
@@ -177,10 +217,26 @@ Farm::~Farm()
     if (nvmlh)
         wrap_nvml_destroy(nvmlh);
 
+    // Pending device changes are dropped, the running one completes
+    m_deviceWork.reset();
+    m_deviceService.stop();
+    m_deviceThread.join();
+
     // Stop mining (if needed)
     if (m_isMining.load(std::memory_order_relaxed))
         stop();
 
+    saveLedger(true);
+
+    // Stop verifiers. Solutions still pending are dropped
+    {
+        Guard l(x_verify);
+        m_verifyStop = true;
+    }
+    m_verifySignal.notify_all();
+    for (auto& verifier : m_verifiers)
+        verifier.join();
+
     DEV_BUILD_LOG_PROGRAMFLOW(cnote, "Farm::~Farm() end");
 }
 
@@ -199,7 +255,7 @@ void Farm::shuffle()
 
 void Farm::setWork(WorkPackage const& _newWp)
 {
-    // Set work to each miner giving it's own starting nonce
+    // Serializes publishers. Miners never take this lock to read work
     Guard l(x_minerWork);
 
     // Retrieve appropriate EpochContext
@@ -219,29 +275,73 @@ void Farm::setWork(WorkPackage const& _newWp)
 
     m_currentWp = _newWp;
 
+    // Coverage carries over while the job stays the same : on resume,
+    // restart or the same job sent again. One persisted by a previous run
+    // is picked up when its job comes in
+    bool sameJob = m_ledger && m_ledger->header() == m_currentWp.header;
+    if (!sameJob && m_savedLedger && m_savedLedger->header() == m_currentWp.header)
+    {
+        cnote << "Job " << m_currentWp.header.abridged() << " resumed with "
+              << m_savedLedger->covered() << " nonces already scanned";
+        m_ledger = std::move(m_savedLedger);
+        sameJob = true;
+    }
+
     // Check if we need to shuffle per work (ergodicity == 2)
-    if (m_Settings.ergodicity == 2 && m_currentWp.exSizeBytes == 0)
+    if (m_Settings.ergodicity == 2 && m_currentWp.exSizeBytes == 0 && !sameJob)
         shuffle();
 
-    uint64_t _startNonce;
-    if (m_currentWp.exSizeBytes > 0)
-    {
-        // Equally divide the residual segment among miners
-        _startNonce = m_currentWp.startNonce;
-        m_nonce_segment_with =
-            (unsigned int)log2(pow(2, 64 - (m_currentWp.exSizeBytes * 4)) / m_miners.size());
-    }
-    else
+    // Nonce space starts past the extranonce, else at the randomly
+    // selected nonce. Same segment as the coverage was recorded on
+    if (m_currentWp.exSizeBytes == 0)
     {
-        // Get the randomly selected nonce
-        _startNonce = m_nonce_scrambler;
+        if (sameJob)
+            m_nonce_scrambler = m_ledger->base();
+        m_currentWp.startNonce = m_nonce_scrambler;
     }
+    if (!sameJob)
+        m_ledger = std::make_shared<NonceLedger>(m_currentWp.header, m_currentWp.startNonce);
 
-    for (unsigned int i = 0; i < m_miners.size(); i++)
+    publishCurrentWork();
+}
+
+/**
+ * @brief Splits the nonce space of current work among miners and
+ * publishes it. Called with x_minerWork held
+ */
+void Farm::publishCurrentWork()
+{
+    // Nonce space shared by miners : the residual one past the extranonce,
+    // else one segment per miner
+    size_t miners = std::max(m_miners.size(), (size_t)1);
+    const uint64_t _startNonce = m_currentWp.startNonce;
+    long double space;
+    if (m_currentWp.exSizeBytes > 0)
     {
-        m_currentWp.startNonce = _startNonce + ((uint64_t)i << m_nonce_segment_with);
-        m_miners.at(i)->setWork(m_currentWp);
+        space = pow(2.0L, 64 - (m_currentWp.exSizeBytes * 4));
+        m_nonce_segment_with = (unsigned int)log2(space / miners);
     }
+    else
+        space = ldexp((long double)miners, m_nonce_segment_with);
+    space = std::min(space, 18446744073709551615.0L);
+
+    // Single publication for all miners. The job is allocated once here
+    // and shared by miners and the solutions they find
+    auto snapshot = std::make_shared<WorkSnapshot>();
+    snapshot->job = std::make_shared<const WorkPackage>(m_currentWp);
+    snapshot->ledger = m_ledger;
+
+    // Ranges go by miner's index, those of devices gone are left empty
+    std::vector<RangeShare> shares;
+    for (auto const& miner : m_miners)
+        shares.push_back(
+            RangeShare{miner->Index(), miner->honoursRange(), miner->RetrieveHashRate()});
+    snapshot->split(_startNonce, space, m_telemetry.miners.size(), shares);
+
+    m_snapshot = snapshot;
+    Miner::publishWork(snapshot);
+    for (auto const& miner : m_miners)
+        miner->kick_miner();
 }
 
 /**
@@ -260,54 +360,206 @@ bool Farm::start()
     if (!m_miners.size())
     {
         for (auto it = m_DevicesCollection.begin(); it != m_DevicesCollection.end(); it++)
-        {
-            TelemetryAccountType minerTelemetry;
+            addMiner(it->first, it->second);
+
+        // Initialize DAG Load mode. A sequence can't skip indexes of
+        // devices gone since they were first seen
+        unsigned dagLoadMode = m_Settings.dagLoadMode;
+        if (m_miners.size() != m_telemetry.miners.size())
+            dagLoadMode = DAG_LOAD_MODE_PARALLEL;
+        Miner::setDagLoadInfo(dagLoadMode, (unsigned int)m_miners.size());
+
+        m_isMining.store(true, std::memory_order_relaxed);
+    }
+    else
+    {
+        for (auto const& miner : m_miners)
+            miner->startWorking();
+        m_isMining.store(true, std::memory_order_relaxed);
+    }
+
+    DEV_BUILD_LOG_PROGRAMFLOW(cnote, "Farm::start() end");
+    return m_isMining.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Creates and starts the miner of a device, if subscribed.
+ * A device keeps the index it was given when first seen
+ */
+std::shared_ptr<Miner> Farm::addMiner(std::string const& _id, DeviceDescriptor _device)
+{
+    auto known = m_minerIndexes.find(_id);
+    unsigned index =
+        known != m_minerIndexes.end() ? known->second : (unsigned)m_telemetry.miners.size();
+
+    TelemetryAccountType minerTelemetry;
+    std::shared_ptr<Miner> miner;
 #if ETC_KECCAKCUDA
-            if (it->second.subscriptionType == DeviceSubscriptionTypeEnum::Cuda)
-            {
-                minerTelemetry.prefix = "cu";
-                m_miners.push_back(std::shared_ptr<Miner>(
-                    new CUDAMiner(m_miners.size(), m_CUSettings, it->second)));
-            }
+    if (_device.subscriptionType == DeviceSubscriptionTypeEnum::Cuda)
+    {
+        minerTelemetry.prefix = "cu";
+        miner = std::make_shared<CUDAMiner>(index, m_CUSettings, _device);
+    }
 #endif
 #if ETC_KECCAKCL
-
-            if (it->second.subscriptionType == DeviceSubscriptionTypeEnum::OpenCL)
-            {
-                minerTelemetry.prefix = "cl";
-                m_miners.push_back(std::shared_ptr<Miner>(
-                    new CLMiner(m_miners.size(), m_CLSettings, it->second)));
-            }
+    if (_device.subscriptionType == DeviceSubscriptionTypeEnum::OpenCL)
+    {
+        minerTelemetry.prefix = "cl";
+        miner = std::make_shared<CLMiner>(index, m_CLSettings, _device);
+    }
 #endif
 #if ETC_KECCAKCPU
-
-            if (it->second.subscriptionType == DeviceSubscriptionTypeEnum::Cpu)
-            {
-                minerTelemetry.prefix = "cp";
-                m_miners.push_back(std::shared_ptr<Miner>(
-                    new CPUMiner(m_miners.size(), m_CPSettings, it->second)));
-            }
+    if (_device.subscriptionType == DeviceSubscriptionTypeEnum::Cpu)
+    {
+        minerTelemetry.prefix = "cp";
+        miner = std::make_shared<CPUMiner>(index, m_CPSettings, _device);
+    }
 #endif
-            if (minerTelemetry.prefix.empty())
-                continue;
+    if (!miner)
+        return nullptr;
+
+    // Past shares stay with the index
+    {
+        Guard t(x_telemetry);
+        if (known == m_minerIndexes.end())
+        {
+            m_minerIndexes[_id] = index;
             m_telemetry.miners.push_back(minerTelemetry);
-            m_miners.back()->startWorking();
         }
+        else
+        {
+            m_telemetry.miners.at(index).prefix = minerTelemetry.prefix;
+            m_telemetry.miners.at(index).removed = false;
+        }
+    }
 
-        // Initialize DAG Load mode
-        Miner::setDagLoadInfo(m_Settings.dagLoadMode, (unsigned int)m_miners.size());
+    // Picks up current work on its own. Joining a running farm it can't
+    // take part in a DAG load sequence the others may be going through
+    miner->setEpoch(m_currentEc);
+    if (isMining())
+        miner->skipDagLoadSequence();
+    if (m_paused.load(std::memory_order_relaxed))
+        miner->pause(MinerPauseEnum::PauseDueToFarmPaused);
+    m_miners.push_back(miner);
+
+    // A device new to the current job has no range in it : split the
+    // job again before it starts, rather than let it claim spare nonces
+    // it may not stop at
+    if (m_snapshot && index >= m_snapshot->ranges.size())
+        publishCurrentWork();
+
+    miner->startWorking();
+    return miner;
+}
 
-        m_isMining.store(true, std::memory_order_relaxed);
+/**
+ * @brief Takes the miner of given index out of the collection.
+ * Caller destroys it once x_minerWork is released, which waits for its thread
+ */
+std::shared_ptr<Miner> Farm::takeMiner(unsigned _index)
+{
+    auto it = std::find_if(m_miners.begin(), m_miners.end(),
+        [&](std::shared_ptr<Miner> const& m) { return m->Index() == _index; });
+    if (it == m_miners.end())
+        return nullptr;
+
+    std::shared_ptr<Miner> miner = *it;
+    m_miners.erase(it);
+    miner->triggerStopWorking();
+    miner->kick_miner();
+    return miner;
+}
+
+bool Farm::restartMiner(unsigned _index)
+{
+    std::shared_ptr<Miner> old;
+    {
+        Guard l(x_minerWork);
+        old = takeMiner(_index);
     }
-    else
+    if (!old)
+        return false;
+
+    // Wait for the thread to leave the device before opening it again.
+    // Holders of getMiners() copies may keep the instance itself alive
+    DeviceDescriptor device = old->getDescriptor();
+    old->stopWorking();
+    old.reset();
+
+    Guard l(x_minerWork);
+    if (!isMining())
+        return true;
+
+    cnote << "Restarting " << m_telemetry.miners.at(_index).prefix << _index << " ...";
+    return addMiner(device.uniqueId, device) != nullptr;
+}
+
+void Farm::restartMiner_async(unsigned _index)
+{
+    m_deviceService.post(boost::bind(&Farm::restartMiner, this, _index));
+}
+
+void Farm::rescanDevices()
+{
+    if (!m_onDevicesRescan)
+        return;
+
+    std::map<std::string, DeviceDescriptor> found;
+    try
     {
-        for (auto const& miner : m_miners)
-            miner->startWorking();
-        m_isMining.store(true, std::memory_order_relaxed);
+        m_onDevicesRescan(found);
+    }
+    catch (const std::exception& ex)
+    {
+        cwarn << "Devices rescan failed : " << ex.what();
+        return;
     }
 
-    DEV_BUILD_LOG_PROGRAMFLOW(cnote, "Farm::start() end");
-    return m_isMining.load(std::memory_order_relaxed);
+    std::vector<std::shared_ptr<Miner>> gone;
+    {
+        Guard l(x_minerWork);
+        for (auto it = m_DevicesCollection.begin(); it != m_DevicesCollection.end();)
+        {
+            if (found.count(it->first))
+            {
+                it++;
+                continue;
+            }
+            cnote << "Device " << it->first << " " << it->second.name << " is gone";
+            auto index = m_minerIndexes.find(it->first);
+            if (index != m_minerIndexes.end())
+            {
+                gone.push_back(takeMiner(index->second));
+                Guard t(x_telemetry);
+                m_telemetry.miners.at(index->second).removed = true;
+                m_telemetry.miners.at(index->second).hashrate = 0.0f;
+            }
+            it = m_DevicesCollection.erase(it);
+        }
+
+        // Known devices keep their subscription
+        for (auto const& device : found)
+        {
+            if (m_DevicesCollection.count(device.first))
+                continue;
+            m_DevicesCollection[device.first] = device.second;
+            cnote << "Device " << device.first << " " << device.second.name << " found";
+            if (!isMining())
+                continue;
+            addMiner(device.first, device.second);
+        }
+    }
+
+    // Waits for their threads to leave the devices
+    for (auto const& miner : gone)
+        if (miner)
+            miner->stopWorking();
+    gone.clear();
+}
+
+void Farm::rescanDevices_async()
+{
+    m_deviceService.post(boost::bind(&Farm::rescanDevices, this));
 }
 
 /**
@@ -405,6 +657,7 @@ bool Farm::reboot(const std::vector<std::string>& args)
  */
 void Farm::accountSolution(unsigned _minerIdx, SolutionAccountingEnum _accounting)
 {
+    Guard t(x_telemetry);
     if (_accounting == SolutionAccountingEnum::Accepted)
     {
         m_telemetry.farm.solutions.accepted++;
@@ -445,6 +698,7 @@ void Farm::accountSolution(unsigned _minerIdx, SolutionAccountingEnum _accountin
 
 SolutionAccountType Farm::getSolutions()
 {
+    Guard t(x_telemetry);
     return m_telemetry.farm.solutions;
 }
 
@@ -453,6 +707,7 @@ SolutionAccountType Farm::getSolutions()
  */
 SolutionAccountType Farm::getSolutions(unsigned _minerIdx)
 {
+    Guard t(x_telemetry);
     try
     {
         return m_telemetry.miners.at(_minerIdx).solutions;
@@ -469,14 +724,55 @@ SolutionAccountType Farm::getSolutions(unsigned _minerIdx)
  */
 Json::Value Farm::get_nonce_scrambler_json()
 {
+    std::shared_ptr<const WorkSnapshot> snapshot;
+    std::vector<unsigned> indexes;
     Json::Value jRes;
-    jRes["start_nonce"] = toHex(m_nonce_scrambler, HexPrefix::Add);
-    jRes["device_width"] = m_nonce_segment_with;
-    jRes["device_count"] = (uint64_t)m_miners.size();
+    {
+        Guard l(x_minerWork);
+        snapshot = m_snapshot;
+        for (auto const& miner : m_miners)
+            indexes.push_back(miner->Index());
+        jRes["start_nonce"] = toHex(m_nonce_scrambler, HexPrefix::Add);
+        jRes["device_width"] = m_nonce_segment_with;
+    }
+    jRes["device_count"] = (uint64_t)indexes.size();
+
+    // Ranges as published with current work : miners honouring a range
+    // go on with chunks of the spare range once through theirs
+    auto segment = [](NonceRange const& _range) {
+        Json::Value jSegment = Json::Value(Json::arrayValue);
+        jSegment.append(toHex(_range.start, HexPrefix::Add));
+        jSegment.append(toHex(_range.end, HexPrefix::Add));
+        return jSegment;
+    };
+    Json::Value jDevices = Json::Value(Json::arrayValue);
+    for (unsigned index : indexes)
+    {
+        Json::Value jDevice;
+        jDevice["index"] = index;
+        if (snapshot && index < snapshot->ranges.size())
+            jDevice["segment"] = segment(snapshot->ranges[index]);
+        jDevices.append(jDevice);
+    }
+    jRes["devices"] = jDevices;
+    if (snapshot)
+    {
+        jRes["spare"] = segment(snapshot->spare);
+        jRes["spare_claimed"] = (uint64_t)std::min(
+            snapshot->spareClaimed.load(std::memory_order_relaxed), snapshot->spare.size());
+    }
 
     return jRes;
 }
 
+NonceRange Farm::get_nonce_range(unsigned _index)
+{
+    Guard l(x_minerWork);
+    if (!m_snapshot || _index >= m_snapshot->ranges.size())
+        return NonceRange{0, 0};
+    return m_snapshot->ranges[_index];
+}
+
 void Farm::setTStartTStop(unsigned tstart, unsigned tstop)
 {
     m_Settings.tempStart = tstart;
@@ -485,25 +781,89 @@ void Farm::setTStartTStop(unsigned tstart, unsigned tstop)
 
 void Farm::submitProof(Solution const& _s)
 {
-    g_io_service.post(m_io_strand.wrap(boost::bind(&Farm::submitProofAsync, this, _s)));
+    // Overlapping segments, kernel re-reads or restarts within
+    // the same job may yield the same share twice
+    if (!m_shareFilter.insert(_s.work->header, _s.nonce))
+    {
+        cwarn << "Dropped duplicate solution " << toHex(_s.nonce, HexPrefix::Add) << " from miner "
+              << _s.midx;
+        return;
+    }
+
+    if (m_Settings.noEval)
+    {
+        g_io_service.post(boost::bind(&Farm::forwardSolution, this, _s));
+        return;
+    }
+
+    {
+        Guard l(x_verify);
+        m_pendingSolutions.push_back(_s);
+    }
+    m_verifySignal.notify_one();
 }
 
-void Farm::submitProofAsync(Solution const& _s)
+void Farm::verifyLoop()
 {
-    if (!m_Settings.noEval)
+    setThreadName("verify");
+
+    std::deque<Solution> batch;
+    std::vector<uint64_t> nonces;
+    std::vector<Result> results;
+    while (true)
     {
-        Result r = KeccakAux::eval(_s.work.header, _s.nonce);
-        if (r.value > _s.work.boundary)
         {
-            accountSolution(_s.midx, SolutionAccountingEnum::Failed);
-            cwarn << "GPU " << _s.midx
-                  << " gave incorrect result. Lower overclocking values if it happens frequently.";
-            return;
+            std::unique_lock<Mutex> l(x_verify);
+            m_verifySignal.wait(l, [this] { return m_verifyStop || !m_pendingSolutions.empty(); });
+            if (m_verifyStop)
+                break;
+            batch.swap(m_pendingSolutions);
         }
-        m_onSolutionFound(Solution{_s.nonce, r.value, _s.work, _s.tstamp, _s.midx});
+
+        // Solutions of the same header are hashed with a single evalBatch
+        // call, which sets up the job once
+        std::stable_sort(batch.begin(), batch.end(), [](Solution const& _a, Solution const& _b) {
+            return _a.work->header < _b.work->header;
+        });
+        for (size_t i = 0; i < batch.size();)
+        {
+            size_t end = i + 1;
+            while (end < batch.size() && batch[end].work->header == batch[i].work->header)
+                end++;
+            nonces.clear();
+            for (size_t j = i; j < end; j++)
+                nonces.push_back(batch[j].nonce);
+            KeccakAux::evalBatch(
+                batch[i].work->header, vector_ref<const uint64_t>(&nonces), results);
+
+            for (size_t j = i; j < end; j++)
+            {
+                Solution& s = batch[j];
+                Result const& r = results[j - i];
+                if (r.value > s.work->boundary)
+                {
+                    g_io_service.post(m_io_strand.wrap(boost::bind(
+                        &Farm::accountSolution, this, s.midx, SolutionAccountingEnum::Failed)));
+                    cwarn << "GPU " << s.midx
+                          << " gave incorrect result. Lower overclocking values if it happens "
+                             "frequently.";
+                    continue;
+                }
+                s.mixHash = r.value;
+
+                // Pool clients are driven from the io thread : only valid
+                // solutions go there, bypassing the strand collectData runs on
+                g_io_service.post(boost::bind(&Farm::forwardSolution, this, s));
+            }
+            i = end;
+        }
+        batch.clear();
     }
-    else
-        m_onSolutionFound(_s);
+}
+
+void Farm::forwardSolution(Solution const& _s)
+{
+    m_onSolutionFound(_s);
 
 #ifdef DEV_BUILD
     if (g_logOptions & LOG_SUBMIT)
@@ -521,17 +881,36 @@ void Farm::collectData(const boost::system::error_code& ec)
     if (ec)
         return;
 
+    auto now = std::chrono::steady_clock::now();
+
+    // Miners first : telemetry then has an entry for each of them
+    std::vector<std::shared_ptr<Miner>> miners = getMiners();
+    {
+        Guard t(x_telemetry);
+        if (m_meters.size() < m_telemetry.miners.size())
+            m_meters.resize(m_telemetry.miners.size());
+    }
+
     // Reset hashrate (it will accumulate from miners)
     float farm_hr = 0.0f;
 
     // Process miners
-    for (auto const& miner : m_miners)
+    for (auto const& miner : miners)
     {
         int minerIdx = miner->Index();
-        float hr = (miner->paused() ? 0.0f : miner->RetrieveHashRate());
+        HashRateMeter& meter = m_meters.at(minerIdx);
+        m_farmHashes += meter.sample(miner->RetrieveHashCount(), now);
+        float hr = (miner->paused() ? 0.0f : meter.rates().ewma[1]);
+        miner->publishHashRate(hr);
         farm_hr += hr;
-        m_telemetry.miners.at(minerIdx).hashrate = hr;
-        m_telemetry.miners.at(minerIdx).paused = miner->paused();
+        HwCountersType counters = miner->RetrieveCounters();
+        {
+            Guard t(x_telemetry);
+            m_telemetry.miners.at(minerIdx).hashrate = hr;
+            m_telemetry.miners.at(minerIdx).rates = meter.rates();
+            m_telemetry.miners.at(minerIdx).paused = miner->paused();
+            m_telemetry.miners.at(minerIdx).counters = counters;
+        }
 
 
         if (m_Settings.hwMon)
@@ -638,20 +1017,108 @@ void Farm::collectData(const boost::system::error_code& ec)
                     miner->resume(MinerPauseEnum::PauseDueToOverHeating);
             }
 
+            Guard t(x_telemetry);
             m_telemetry.miners.at(minerIdx).sensors.tempC = tempC;
             m_telemetry.miners.at(minerIdx).sensors.fanP = fanpcnt;
             m_telemetry.miners.at(minerIdx).sensors.powerW = powerW / ((double)1000.0);
         }
+    }
+
+    m_farmMeter.sample(m_farmHashes, now);
+    {
+        Guard t(x_telemetry);
         m_telemetry.farm.hashrate = farm_hr;
-        miner->TriggerHashRateUpdate();
+        m_telemetry.farm.rates = m_farmMeter.rates();
     }
 
+    saveLedger();
+
     // Resubmit timer for another loop
     m_collectTimer.expires_from_now(boost::posix_time::milliseconds(m_collectInterval));
     m_collectTimer.async_wait(
         m_io_strand.wrap(boost::bind(&Farm::collectData, this, boost::asio::placeholders::error)));
 }
 
+void Farm::saveLedger(bool _force)
+{
+    if (m_Settings.nonceLedger.empty())
+        return;
+
+    // Coverage changes all the time while mining : don't rewrite the
+    // file on every collect tick
+    auto now = std::chrono::steady_clock::now();
+    if (!_force && now - m_ledgerSaved < c_ledgerSaveInterval)
+        return;
+
+    std::shared_ptr<NonceLedger> ledger;
+    {
+        Guard l(x_minerWork);
+        ledger = m_ledger;
+    }
+    if (!ledger || !ledger->dirty())
+        return;
+    m_ledgerSaved = now;
+    if (!ledger->save(m_Settings.nonceLedger))
+        cwarn << "Could not save nonce ledger to " << m_Settings.nonceLedger << " : "
+              << strerror(errno);
+}
+
+void Farm::recordHistory(const boost::system::error_code& ec)
+{
+    if (ec)
+        return;
+
+    auto clock = std::chrono::steady_clock::now();
+    uint64_t time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    double elapsed = std::chrono::duration<double>(clock - m_historyClock).count();
+
+    // Miners first : the telemetry copy then has an entry for each of them
+    std::vector<std::shared_ptr<Miner>> miners = getMiners();
+    TelemetryType telemetry = Telemetry();
+    size_t count = telemetry.miners.size();
+    m_historyHashes.resize(count);
+    m_historyShares.resize(count);
+    std::vector<TelemetrySample> samples(count);
+    for (auto const& miner : miners)
+    {
+        unsigned idx = miner->Index();
+        TelemetryAccountType const& t = telemetry.miners.at(idx);
+        TelemetrySample& s = samples[idx];
+
+        // Counter restarts along with its miner
+        uint64_t hashes = miner->RetrieveHashCount();
+        if (hashes >= m_historyHashes[idx])
+            s.hashrate = float((hashes - m_historyHashes[idx]) / elapsed);
+        m_historyHashes[idx] = hashes;
+
+        SolutionAccountType& last = m_historyShares[idx];
+        auto delta = [](unsigned now, unsigned before) {
+            return now >= before ? now - before : now;
+        };
+        s.accepted = delta(t.solutions.accepted, last.accepted);
+        s.rejected = delta(t.solutions.rejected, last.rejected);
+        s.failed = delta(t.solutions.failed, last.failed);
+        last = t.solutions;
+
+        s.tempC = float(t.sensors.tempC);
+        s.fanP = float(t.sensors.fanP);
+        s.powerW = float(t.sensors.powerW);
+        s.switchMs = miner->RetrieveSwitchLatency() / 1000.0f;
+    }
+
+    // First call only sets the baseline
+    if (m_historyTime)
+        m_history.record(m_historyTime, samples);
+    m_historyTime = time;
+    m_historyClock = clock;
+
+    // Relative to previous deadline, not to now, so that periods don't drift
+    m_historyTimer.expires_at(
+        m_historyTimer.expires_at() + boost::posix_time::seconds(m_history.resolution()));
+    m_historyTimer.async_wait(m_io_strand.wrap(
+        boost::bind(&Farm::recordHistory, this, boost::asio::placeholders::error)));
+}
+
 bool Farm::spawn_file_in_bin_dir(const char* filename, const std::vector<std::string>& args)
 {
     std::string fn = boost::dll::program_location().parent_path().string() +
@@ -17,7 +17,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <list>
 #include <thread>
 
@@ -32,7 +35,10 @@
 #include <libdevcore/Common.h>
 #include <libdevcore/Worker.h>
 
+#include <libkeccakcore/HashRateMeter.h>
 #include <libkeccakcore/Miner.h>
+#include <libkeccakcore/ShareFilter.h>
+#include <libkeccakcore/TelemetryHistory.h>
 
 #include <libhwmon/wrapnvml.h>
 #if defined(__linux)
@@ -56,6 +62,8 @@ struct FarmSettings
     unsigned ergodicity = 0;   // 0=default, 1=per session, 2=per job
     unsigned tempStart = 40;   // Temperature threshold to restart mining (if paused)
     unsigned tempStop = 0;     // Temperature threshold to pause mining (overheating)
+    std::string nonceLedger;   // File persisting nonce coverage of current job. Empty = memory only
+    std::string telemetryHistory = "1:3600,60:86400";  // Tiers of TelemetryHistory::parse
 };
 
 /**
@@ -136,40 +144,82 @@ public:
 
     /**
      * @brief Get information on the progress of mining this work package.
-     * @return The progress with mining so far.
+     * @return A copy of the progress with mining so far : miners may be
+     * added while it is read
      */
-    TelemetryType& Telemetry() { return m_telemetry; }
+    TelemetryType Telemetry() const
+    {
+        Guard l(x_telemetry);
+        return m_telemetry;
+    }
+
+    /**
+     * @brief Gets past telemetry of miners
+     */
+    TelemetryHistory const& History() const { return m_history; }
 
     /**
      * @brief Gets current hashrate
      */
-    float HashRate() { return m_telemetry.farm.hashrate; };
+    float HashRate()
+    {
+        Guard l(x_telemetry);
+        return m_telemetry.farm.hashrate;
+    };
 
     /**
      * @brief Gets the collection of pointers to miner instances
      */
-    std::vector<std::shared_ptr<Miner>> getMiners() { return m_miners; }
+    std::vector<std::shared_ptr<Miner>> getMiners()
+    {
+        Guard l(x_minerWork);
+        return m_miners;
+    }
 
     /**
      * @brief Gets the number of miner instances
      */
-    unsigned getMinersCount() { return (unsigned)m_miners.size(); };
+    unsigned getMinersCount()
+    {
+        Guard l(x_minerWork);
+        return (unsigned)m_miners.size();
+    };
 
     /**
      * @brief Gets the pointer to a miner instance
      */
     std::shared_ptr<Miner> getMiner(unsigned index)
     {
-        try
-        {
-            return m_miners.at(index);
-        }
-        catch (const std::exception&)
-        {
-            return nullptr;
-        }
+        Guard l(x_minerWork);
+        for (auto const& miner : m_miners)
+            if (miner->Index() == index)
+                return miner;
+        return nullptr;
     }
 
+    /**
+     * @brief Stops the miner of given index and starts a new one on the same
+     * device, keeping its index. Other miners go on hashing
+     * @return false if there is no such miner
+     */
+    bool restartMiner(unsigned _index);
+
+    /**
+     * @brief Same as above but posted to the farm's device thread
+     */
+    void restartMiner_async(unsigned _index);
+
+    /**
+     * @brief Enumerates devices again through the handler set with onDevicesRescan().
+     * Starts miners on devices which appeared, stops those of devices which are gone
+     */
+    void rescanDevices();
+
+    /**
+     * @brief Same as above but posted to the farm's device thread
+     */
+    void rescanDevices_async();
+
     /**
      * @brief Accounts a solution to a miner and, as a consequence, to
      *  the whole farm
@@ -188,6 +238,7 @@ public:
 
     using SolutionFound = std::function<void(const Solution&)>;
     using MinerRestart = std::function<void()>;
+    using DevicesRescan = std::function<void(std::map<std::string, DeviceDescriptor>&)>;
 
     /**
      * @brief Provides a valid header based upon that received previously with setWork().
@@ -199,6 +250,11 @@ public:
 
     void onMinerRestart(MinerRestart const& _handler) { m_onMinerRestart = _handler; }
 
+    /**
+     * @brief Sets how to enumerate and subscribe devices when rescanning
+     */
+    void onDevicesRescan(DevicesRescan const& _handler) { m_onDevicesRescan = _handler; }
+
     /**
      * @brief Gets the actual start nonce of the segment picked by the farm
      */
@@ -229,6 +285,12 @@ public:
      */
     Json::Value get_nonce_scrambler_json();
 
+    /**
+     * @brief Gets the nonce range current work assigned to a miner
+     * @return an empty range if it has none
+     */
+    NonceRange get_nonce_range(unsigned _index);
+
     void setTStartTStop(unsigned tstart, unsigned tstop);
 
     unsigned get_tstart() override { return m_Settings.tempStart; }
@@ -246,13 +308,30 @@ public:
 private:
     std::atomic<bool> m_paused = {false};
 
-    // Async submits solution serializing execution
-    // in Farm's strand
-    void submitProofAsync(Solution const& _s);
+    // Share verification threads : re-hash pending solutions in
+    // batches off the io thread
+    void verifyLoop();
+
+    // Hands a verified solution to the pool client on the io thread
+    void forwardSolution(Solution const& _s);
 
     // Collects data about hashing and hardware status
     void collectData(const boost::system::error_code& ec);
 
+    // Writes current job's nonce coverage to disk when it changed, at
+    // most once per c_ledgerSaveInterval unless forced
+    void saveLedger(bool _force = false);
+
+    // Splits current work among miners and publishes it. Called with x_minerWork held
+    void publishCurrentWork();
+
+    // Miners collection changes. Called with x_minerWork held
+    std::shared_ptr<Miner> addMiner(std::string const& _id, DeviceDescriptor _device);
+    std::shared_ptr<Miner> takeMiner(unsigned _index);
+
+    // Appends what miners did since previous call to the history
+    void recordHistory(const boost::system::error_code& ec);
+
     /**
      * @brief Spawn a file - must be located in the directory of keccakminer binary
      * @return false if file was not found or it is not executeable
@@ -261,23 +340,54 @@ private:
 
     mutable Mutex x_minerWork;
     std::vector<std::shared_ptr<Miner>> m_miners;  // Collection of miners
+    std::map<std::string, unsigned> m_minerIndexes;  // Device's unique id to its miner's index
 
     WorkPackage m_currentWp;
     EpochContext m_currentEc;
+    std::shared_ptr<NonceLedger> m_ledger;       // Nonces of current job already scanned
+    std::shared_ptr<NonceLedger> m_savedLedger;  // Loaded at startup till its job comes in
+    std::shared_ptr<const WorkSnapshot> m_snapshot;  // Last one published
+    std::chrono::steady_clock::time_point m_ledgerSaved;  // Last write of the ledger file
 
     std::atomic<bool> m_isMining = {false};
 
+    mutable Mutex x_telemetry;  // Held by readers off the strand and by miners additions
     TelemetryType m_telemetry;  // Holds progress and status info for farm and miners
 
+    std::vector<HashRateMeter> m_meters;  // Rates of each miner, by miner's index
+    HashRateMeter m_farmMeter;
+    uint64_t m_farmHashes = 0;  // Sum of miners' counter deltas
+
     SolutionFound m_onSolutionFound;
     MinerRestart m_onMinerRestart;
+    DevicesRescan m_onDevicesRescan;
+
+    ShareFilter m_shareFilter;  // Drops (job, nonce) pairs already submitted
+
+    std::vector<std::thread> m_verifiers;
+    Mutex x_verify;
+    std::condition_variable m_verifySignal;
+    std::deque<Solution> m_pendingSolutions;  // Submitted by miners, not yet verified
+    bool m_verifyStop = false;
 
     FarmSettings m_Settings;  // Own Farm Settings
     CUSettings m_CUSettings;  // Cuda settings passed to CUDA Miner instantiator
     CLSettings m_CLSettings;  // OpenCL settings passed to CL Miner instantiator
     CPSettings m_CPSettings;  // CPU settings passed to CPU Miner instantiator
 
+    TelemetryHistory m_history;
+    boost::asio::deadline_timer m_historyTimer;
+    uint64_t m_historyTime = 0;  // Unix time of previous record
+    std::chrono::steady_clock::time_point m_historyClock;
+    std::vector<uint64_t> m_historyHashes;             // Miners' counters at previous record
+    std::vector<SolutionAccountType> m_historyShares;  // Miners' shares at previous record
+
     boost::asio::io_service::strand m_io_strand;
+
+    // Runs restartMiner and rescanDevices one at a time, off the io strand
+    boost::asio::io_service m_deviceService;
+    std::unique_ptr<boost::asio::io_service::work> m_deviceWork;
+    std::thread m_deviceThread;
     boost::asio::deadline_timer m_collectTimer;
     static const int m_collectInterval = 5000;
 
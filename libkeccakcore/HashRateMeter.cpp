@@ -0,0 +1,84 @@
+/*
+ This file is part of keccakminer.
+
+ keccakminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ keccakminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+
+#include "HashRateMeter.h"
+
+using namespace std::chrono;
+
+namespace dev
+{
+namespace etc
+{
+namespace
+{
+// Time constants of ewma[] and lengths of window[], in seconds
+const double c_periods[3] = {10.0, 60.0, 900.0};
+}  // namespace
+
+uint64_t HashRateMeter::sample(uint64_t _count, steady_clock::time_point _time)
+{
+    if (!m_readings.empty() && _count < m_readings.back().second)
+        reset();
+    if (m_readings.empty())
+    {
+        m_readings.emplace_back(_time, _count);
+        return 0;
+    }
+
+    Reading const& last = m_readings.back();
+    double dt = duration<double>(_time - last.first).count();
+    if (dt <= 0.0)
+        return 0;
+    uint64_t delta = _count - last.second;
+    double rate = delta / dt;
+    m_readings.emplace_back(_time, _count);
+
+    // Forget readings no longer needed by the longest window, keeping
+    // the one it starts from
+    auto longest = duration_cast<steady_clock::duration>(duration<double>(c_periods[2]));
+    while (m_readings.size() > 2 && m_readings[1].first <= _time - longest)
+        m_readings.pop_front();
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        // First rate seeds the averages, so that long ones need not ramp up from 0
+        double alpha = m_primed ? 1.0 - std::exp(-dt / c_periods[i]) : 1.0;
+        m_rates.ewma[i] += float(alpha * (rate - m_rates.ewma[i]));
+
+        // Latest reading at least a window old, or the oldest one
+        auto window = duration_cast<steady_clock::duration>(duration<double>(c_periods[i]));
+        auto from = m_readings.rbegin() + 1;
+        while (from + 1 != m_readings.rend() && from->first > _time - window)
+            from++;
+        m_rates.window[i] = float(
+            (_count - from->second) / duration<double>(_time - from->first).count());
+    }
+    m_primed = true;
+    return delta;
+}
+
+void HashRateMeter::reset()
+{
+    m_readings.clear();
+    m_rates = HashRateType();
+    m_primed = false;
+}
+
+}  // namespace etc
+}  // namespace dev
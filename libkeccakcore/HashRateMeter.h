@@ -0,0 +1,58 @@
+/*
+ This file is part of keccakminer.
+
+ keccakminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ keccakminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <utility>
+
+#include "Miner.h"
+
+namespace dev
+{
+namespace etc
+{
+/**
+ * @brief Turns successive readings of a monotonic hash counter into
+ * moving averages (see HashRateType) out of counter deltas.
+ * Not thread safe : meant to be fed by the farm's collector only
+ */
+class HashRateMeter
+{
+public:
+    /**
+     * @brief Records a reading of the counter.
+     * A counter going backwards (miner restarted) restarts the meter
+     * @return Hashes counted since previous reading
+     */
+    uint64_t sample(uint64_t _count, std::chrono::steady_clock::time_point _time);
+
+    HashRateType const& rates() const { return m_rates; }
+
+    void reset();
+
+private:
+    typedef std::pair<std::chrono::steady_clock::time_point, uint64_t> Reading;
+
+    std::deque<Reading> m_readings;  // Oldest first, back to the longest window
+    HashRateType m_rates;
+    bool m_primed = false;  // Whether or not averages hold a rate yet
+};
+
+}  // namespace etc
+}  // namespace dev
@@ -16,26 +16,92 @@
 */
 
 #include "KeccakAux.h"
+#include "KeccakFormat.h"
+#include "KeccakRounds.h"
 
-#include <ethash/ethash.hpp>
-#include <ethash/keccak.hpp>
+#if ETC_KECCAKCPU
+#include <libkeccak-cpu/KeccakSearch.h>
+#endif
 
 using namespace dev;
 using namespace etc;
 
+constexpr unsigned KeccakF1600Spec::rho[25];
+constexpr unsigned KeccakF1600Spec::pi[25];
+constexpr uint64_t KeccakF1600Spec::rc[24];
+
+namespace
+{
+typedef Keccak256Format Format;
+static_assert(Format::blocks == 1 && Format::nonceOffset == 32 && Format::nonceBigEndian,
+    "eval hashes a single block made of header hash then big-endian nonce");
+
+inline uint64_t loadLane(const byte* _p)
+{
+    uint64_t lane = 0;
+    for (unsigned i = 0; i < 8; i++)
+        lane |= (uint64_t)_p[i] << (8 * i);
+    return lane;
+}
+
+}  // namespace
+
 Result KeccakAux::eval(h256 const& _headerHash, uint64_t _nonce) noexcept
 {
-    std::array<byte, 40> header;
-    std::array<byte, 8> nonce;
-
-    header.fill(0);
-    nonce.fill(0);
-    
-    toBigEndian(_nonce, nonce);
-
-    memcpy(header.data(), _headerHash.data(), 32);
-    memcpy(header.data() + 32, nonce.data(), 8);
-    auto result = ethash::keccak256(header.data(), 40);
-    h256 final{reinterpret_cast<byte*>(result.bytes), h256::ConstructFromPointer};
+    // Message fits in a single block : no absorb loop, zero lanes are
+    // left out of round 0 and last round only computes the 4 digest lanes
+    uint64_t a[25];
+    for (unsigned i = 0; i < 4; i++)
+        a[i] = loadLane(_headerHash.data() + i * 8);
+    a[4] = 0;
+    for (unsigned i = 0; i < 8; i++)  // Big-endian nonce bytes
+        a[4] |= ((_nonce >> (8 * (7 - i))) & 0xff) << (8 * i);
+    a[5] = Format::pad;
+    a[16] = 0x8000000000000000ULL;
+
+    KeccakRounds<>::permute<0, 4, Format::firstBlockLanes>(a);
+
+    h256 final;
+    for (unsigned i = 0; i < 32; i++)
+        final[i] = (byte)(a[i / 8] >> (8 * (i % 8)));
     return {final};
-}
\ No newline at end of file
+}
+
+void KeccakAux::evalBatch(
+    h256 const& _headerHash, vector_ref<const uint64_t> _nonces, std::vector<Result>& _results)
+{
+    _results.resize(_nonces.size());
+
+#if ETC_KECCAKCPU
+    // SIMD kernels only produce the upper 64 bits of digests : full digests
+    // come from the scalar midstate path
+    WorkPackage wp;
+    wp.header = _headerHash;
+    KeccakSearchJob job;
+    keccakSearchPrepare(job, wp);
+    for (size_t i = 0; i < _nonces.size(); i++)
+        _results[i].value = keccakSearchHash(job, _nonces[i]);
+#else
+    for (size_t i = 0; i < _nonces.size(); i++)
+        _results[i] = eval(_headerHash, _nonces[i]);
+#endif
+}
+
+void KeccakAux::evalBatch(h256 const& _headerHash, h256 const& _boundary,
+    vector_ref<const uint64_t> _nonces, std::vector<uint64_t>& _passed)
+{
+    _passed.assign((_nonces.size() + 63) / 64, 0);
+
+#if ETC_KECCAKCPU
+    WorkPackage wp;
+    wp.header = _headerHash;
+    wp.boundary = _boundary;
+    KeccakSearchJob job;
+    keccakSearchPrepare(job, wp);
+    keccakSearchKernel().verify(job, _nonces.data(), (unsigned)_nonces.size(), _passed.data());
+#else
+    for (size_t i = 0; i < _nonces.size(); i++)
+        if (eval(_headerHash, _nonces[i]).value <= _boundary)
+            _passed[i / 64] |= 1ULL << (i % 64);
+#endif
+}
@@ -17,9 +17,12 @@
 
 #pragma once
 
+#include <memory>
+
 #include <libdevcore/Common.h>
 #include <libdevcore/Exceptions.h>
 #include <libdevcore/Worker.h>
+#include <libdevcore/vector_ref.h>
 
 #include <ethash/ethash.hpp>
 
@@ -36,6 +39,24 @@ class KeccakAux
 {
 public:
     static Result eval(h256 const& _headerHash, uint64_t _nonce) noexcept;
+
+    /**
+     * @brief Digests of many nonces of the same header. Job setup (round 0
+     * midstate) is done once for the whole batch. Shares its midstate code
+     * with CPU kernels : their candidates are confirmed with eval()
+     * @param _results Resized to the number of nonces
+     */
+    static void evalBatch(
+        h256 const& _headerHash, vector_ref<const uint64_t> _nonces, std::vector<Result>& _results);
+
+    /**
+     * @brief Checks many nonces of the same header against a boundary using
+     * the fastest CPU kernel of this host
+     * @param _passed Resized to hold one bit per nonce. Bit i (word i / 64, bit i % 64)
+     * is set when digest of _nonces[i] is lower or equal to _boundary
+     */
+    static void evalBatch(h256 const& _headerHash, h256 const& _boundary,
+        vector_ref<const uint64_t> _nonces, std::vector<uint64_t>& _passed);
 };
 
 struct EpochContext
@@ -73,7 +94,7 @@ struct Solution
 {
     uint64_t nonce;                                // Solution found nonce
     h256 mixHash;                                  // Mix hash
-    WorkPackage work;                              // WorkPackage this solution refers to
+    std::shared_ptr<const WorkPackage> work;       // Immutable job this solution refers to
     std::chrono::steady_clock::time_point tstamp;  // Timestamp of found solution
     unsigned midx;                                 // Originating miner Id
 };
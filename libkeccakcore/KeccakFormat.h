@@ -0,0 +1,224 @@
+/*
+    This file is part of keccakminer.
+
+    keccakminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    keccakminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ Compile time message format policies.
+
+ A format describes the message a miner hashes for each nonce:
+
+   HeaderBytes     length of the job header
+   NonceOffset     byte offset the 8 bytes nonce is inserted at. Header
+                   bytes from there on follow the nonce
+   NonceBigEndian  byte order of the nonce in the message
+   Pad             domain padding byte: 0x01 Keccak, 0x06 SHA3
+
+ Blocks of the padded message entirely before the nonce only depend on the
+ job and are absorbed once into a midstate. Blocks from the one holding the
+ nonce on are hashed per nonce with every lane index, shift and padding
+ constant known at compile time, so each format gets its own fully
+ specialised code with no runtime branching.
+*/
+
+#pragma once
+
+#include <stdexcept>
+
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+
+#include "KeccakRounds.h"
+
+namespace dev
+{
+namespace etc
+{
+template <unsigned HeaderBytes = 32, unsigned NonceOffset = HeaderBytes,
+    bool NonceBigEndian = true, uint8_t Pad = 0x01>
+struct KeccakMessageFormat
+{
+    static_assert(NonceOffset <= HeaderBytes, "Nonce must lie within or right after the header");
+    static_assert(Pad == 0x01 || Pad == 0x06, "Padding is either Keccak (0x01) or SHA3 (0x06)");
+
+    static constexpr unsigned rate = 136;  // Keccak-256 / SHA3-256 block size
+    static constexpr unsigned rateLanes = rate / 8;
+    static constexpr unsigned headerBytes = HeaderBytes;
+    static constexpr unsigned nonceOffset = NonceOffset;
+    static constexpr bool nonceBigEndian = NonceBigEndian;
+    static constexpr uint8_t pad = Pad;
+
+    static constexpr unsigned messageBytes = HeaderBytes + 8;
+    static constexpr unsigned blocks = messageBytes / rate + 1;  // Padding takes at least 1 byte
+    static constexpr unsigned nonceLane = NonceOffset / 8;       // Counted from message start
+    static constexpr unsigned nonceShift = (NonceOffset % 8) * 8;
+    static constexpr unsigned nonceBlock = NonceOffset / rate;  // Blocks before are midstate
+    static constexpr unsigned tailBlocks = blocks - nonceBlock;
+
+    // Lanes of block 0 which may be non zero. Only meaningful without midstate
+    static constexpr uint32_t firstBlockLanes =
+        ((1u << ((messageBytes < rate ? messageBytes : rate) + 7) / 8) - 1) |
+        (blocks == 1 ? (1u << (messageBytes / 8)) | (1u << (rateLanes - 1)) : 0u);
+};
+
+// 32 bytes header hash followed by big-endian nonce
+typedef KeccakMessageFormat<> Keccak256Format;
+
+/**
+ * @brief Per job constants of a format : midstate and tail blocks
+ */
+template <typename Format>
+struct KeccakFormatJob
+{
+    uint64_t state[25];                                // After absorbing blocks before the nonce
+    uint64_t tail[Format::tailBlocks][Format::rateLanes];  // Padded blocks, nonce bytes zeroed
+    h256 boundary;
+    uint64_t target;  // Upper 64 bits of boundary
+};
+
+/**
+ * @brief Hashing of a message format
+ * @threadsafe
+ */
+template <typename Format>
+class KeccakFormatHash
+{
+public:
+    typedef KeccakFormatJob<Format> Job;
+
+    /**
+     * @brief Builds job constants out of the raw header bytes
+     */
+    static void prepare(Job& _job, bytesConstRef _header, h256 const& _boundary)
+    {
+        if (_header.size() != Format::headerBytes)
+            throw std::invalid_argument("Header size does not match message format");
+
+        byte message[Format::blocks * Format::rate] = {};
+        for (unsigned i = 0; i < Format::headerBytes; i++)
+            message[i < Format::nonceOffset ? i : i + 8] = _header[i];
+        message[Format::messageBytes] ^= Format::pad;
+        message[sizeof(message) - 1] ^= 0x80;
+
+        for (unsigned i = 0; i < 25; i++)
+            _job.state[i] = 0;
+        for (unsigned b = 0; b < Format::blocks; b++)
+        {
+            uint64_t* lanes = b < Format::nonceBlock ? _job.state : _job.tail[b - Format::nonceBlock];
+            for (unsigned l = 0; l < Format::rateLanes; l++)
+            {
+                uint64_t lane = 0;
+                for (unsigned i = 0; i < 8; i++)
+                    lane |= (uint64_t)message[b * Format::rate + l * 8 + i] << (8 * i);
+                lanes[l] = b < Format::nonceBlock ? lanes[l] ^ lane : lane;
+            }
+            if (b < Format::nonceBlock)
+                KeccakRounds<>::permute<0, 25>(_job.state);
+        }
+
+        _job.boundary = _boundary;
+        _job.target = 0;
+        for (unsigned i = 0; i < 8; i++)
+            _job.target = (_job.target << 8) | _boundary[i];
+    }
+
+    /**
+     * @brief Full 256 bits digest of a nonce
+     */
+    static h256 hash(Job const& _job, uint64_t _nonce)
+    {
+        uint64_t a[25];
+        absorb<4>(_job, _nonce, a);
+        h256 digest;
+        for (unsigned i = 0; i < 32; i++)
+            digest[i] = (byte)(a[i / 8] >> (8 * (i % 8)));
+        return digest;
+    }
+
+    /**
+     * @brief Upper 64 bits of the digest of a nonce, as a big-endian number
+     */
+    static uint64_t upper(Job const& _job, uint64_t _nonce)
+    {
+        uint64_t a[25];
+        absorb<1>(_job, _nonce, a);
+        return bswap(a[0]);
+    }
+
+    /**
+     * @brief Scalar search kernel. Same contract as KeccakSearchFn
+     */
+    static unsigned search(Job const& _job, uint64_t _startNonce, unsigned _count,
+        uint64_t* _found, unsigned _maxFound)
+    {
+        unsigned found = 0;
+        for (unsigned i = 0; i < _count; i++)
+        {
+            uint64_t nonce = _startNonce + i;
+            if (upper(_job, nonce) <= _job.target && hash(_job, nonce) <= _job.boundary &&
+                found < _maxFound)
+                _found[found++] = nonce;
+        }
+        return found;
+    }
+
+private:
+    static inline uint64_t bswap(uint64_t _x)
+    {
+        _x = ((_x & 0x00ff00ff00ff00ffULL) << 8) | ((_x >> 8) & 0x00ff00ff00ff00ffULL);
+        _x = ((_x & 0x0000ffff0000ffffULL) << 16) | ((_x >> 16) & 0x0000ffff0000ffffULL);
+        return (_x << 32) | (_x >> 32);
+    }
+
+    // Absorbs block B then the following ones. Last permutation only
+    // computes Out lanes
+    template <unsigned B, unsigned Out, bool End = (B == Format::blocks)>
+    struct Absorb
+    {
+        static inline void run(Job const& _job, uint64_t _nonce, uint64_t* a)
+        {
+            constexpr unsigned nextLane = Format::nonceLane + 1;
+            for (unsigned l = 0; l < Format::rateLanes; l++)
+                a[l] ^= _job.tail[B - Format::nonceBlock][l];
+            if (Format::nonceLane / Format::rateLanes == B)
+                a[Format::nonceLane % Format::rateLanes] ^= _nonce << Format::nonceShift;
+            if (Format::nonceShift && nextLane / Format::rateLanes == B)
+                a[nextLane % Format::rateLanes] ^= _nonce >> ((64 - Format::nonceShift) & 63);
+
+            // Without midstate, lanes outside the first block's message are known zero
+            KeccakRounds<>::permute<0, B + 1 == Format::blocks ? Out : 25,
+                B == 0 ? Format::firstBlockLanes : KeccakRounds<>::allLanes>(a);
+            Absorb<B + 1, Out>::run(_job, _nonce, a);
+        }
+    };
+
+    template <unsigned B, unsigned Out>
+    struct Absorb<B, Out, true>
+    {
+        static inline void run(Job const&, uint64_t, uint64_t*) {}
+    };
+
+    template <unsigned Out>
+    static inline void absorb(Job const& _job, uint64_t _nonce, uint64_t* a)
+    {
+        for (unsigned i = 0; i < 25; i++)
+            a[i] = _job.state[i];
+        Absorb<Format::nonceBlock, Out>::run(
+            _job, Format::nonceBigEndian ? bswap(_nonce) : _nonce, a);
+    }
+};
+
+}  // namespace etc
+}  // namespace dev
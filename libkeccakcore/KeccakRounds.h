@@ -0,0 +1,239 @@
+/*
+    This file is part of keccakminer.
+
+    keccakminer is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    keccakminer is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ Compile time generated Keccak-f[1600] rounds.
+
+ A single template definition of the round is instantiated for every
+ hashing path (KeccakAux::eval, CPU search kernels, batch verification)
+ with the knowledge each one has at compile time:
+
+   Spec    rho offsets, pi permutation and round constants
+   Live    bitmask of input lanes which may be non zero (others are
+           known to be zero and are left out of theta)
+   Out     number of output lanes actually needed in the last round
+           (1 = upper 64 bits of digest, 4 = full 256 bits digest)
+
+ Every lane index, rotation and constant is a template argument thus
+ instantiations are fully unrolled and constant folded by the compiler.
+ Only C++11 features are used.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace dev
+{
+namespace etc
+{
+/**
+ * @brief Keccak-f[1600] permutation constants
+ */
+struct KeccakF1600Spec
+{
+    static constexpr unsigned lanes = 25;
+    static constexpr unsigned rounds = 24;
+
+    // Rotation applied to each input lane by rho
+    static constexpr unsigned rho[25] = {0, 1, 62, 28, 27, 36, 44, 6, 55, 20, 3, 10, 43, 25, 39,
+        41, 45, 15, 21, 8, 18, 2, 61, 56, 14};
+
+    // Input lane moved by pi to each output position
+    static constexpr unsigned pi[25] = {
+        0, 6, 12, 18, 24, 3, 9, 10, 16, 22, 1, 7, 13, 19, 20, 4, 5, 11, 17, 23, 2, 8, 14, 15, 21};
+
+    static constexpr uint64_t rc[24] = {0x0000000000000001ULL, 0x0000000000008082ULL,
+        0x800000000000808aULL, 0x8000000080008000ULL, 0x000000000000808bULL,
+        0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+        0x000000000000008aULL, 0x0000000000000088ULL, 0x0000000080008009ULL,
+        0x000000008000000aULL, 0x000000008000808bULL, 0x800000000000008bULL,
+        0x8000000000008089ULL, 0x8000000000008003ULL, 0x8000000000008002ULL,
+        0x8000000000000080ULL, 0x000000000000800aULL, 0x800000008000000aULL,
+        0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL,
+        0x8000000080008008ULL};
+};
+
+/**
+ * @brief Round generator.
+ * Besides a single state, rounds are generated for N independent states
+ * stored lane by lane (a[lane][state]), every step being done for all of
+ * them before the next one. Dependency chains of one state are then
+ * interleaved with the others' which lets out of order cores overlap
+ * their latencies without any SIMD unit
+ * @threadsafe
+ */
+template <typename Spec = KeccakF1600Spec>
+class KeccakRounds
+{
+public:
+    static constexpr uint32_t allLanes = (1u << 25) - 1;
+
+    /**
+     * @brief One round on state a. Out lanes only are written back
+     */
+    template <uint32_t Live, unsigned Out>
+    static inline void round(uint64_t* a, uint64_t _rc)
+    {
+        roundN<Live, Out, 1>(reinterpret_cast<uint64_t(*)[1]>(a), _rc);
+    }
+
+    /**
+     * @brief Rounds First..23. Input lanes outside Live are zero on entry
+     * of round First and only Out lanes are computed by last round
+     */
+    template <unsigned First, unsigned Out, uint32_t Live = allLanes>
+    static inline void permute(uint64_t* a)
+    {
+        permuteN<First, Out, 1, Live>(reinterpret_cast<uint64_t(*)[1]>(a));
+    }
+
+    /**
+     * @brief Same as round() on N interleaved states
+     */
+    template <uint32_t Live, unsigned Out, unsigned N>
+    static inline void roundN(uint64_t (*a)[N], uint64_t _rc)
+    {
+        uint64_t c[5][N];
+        uint64_t d[5][N];
+        uint64_t b[25][N];
+        Unroll<0, 5>::run(Parity<Live, N>{a, c});
+        Unroll<0, 5>::run(Theta<N>{c, d});
+        Unroll<0, (Out + 4) / 5 * 5>::run(RhoPi<Live, N>{a, d, b});
+        Unroll<0, Out>::run(Chi<N>{a, b});
+        for (unsigned k = 0; k < N; k++)
+            a[0][k] ^= _rc;
+    }
+
+    /**
+     * @brief Same as permute() on N interleaved states
+     */
+    template <unsigned First, unsigned Out, unsigned N, uint32_t Live = allLanes>
+    static inline void permuteN(uint64_t (*a)[N])
+    {
+        Rounds<First, Out, Live, N>::run(a);
+    }
+
+private:
+    template <unsigned N>
+    static inline uint64_t rotl(uint64_t _x)
+    {
+        return (_x << N) | (_x >> ((64 - N) & 63));
+    }
+
+    // Calls F::step<I> for I in [I, N)
+    template <unsigned I, unsigned N>
+    struct Unroll
+    {
+        template <typename F>
+        static inline void run(F const& _f)
+        {
+            _f.template step<I>();
+            Unroll<I + 1, N>::run(_f);
+        }
+    };
+
+    template <unsigned N>
+    struct Unroll<N, N>
+    {
+        template <typename F>
+        static inline void run(F const&)
+        {}
+    };
+
+    template <uint32_t Live, unsigned L, unsigned N>
+    static inline uint64_t live(uint64_t const (*a)[N], unsigned k)
+    {
+        return (Live & (1u << L)) ? a[L][k] : 0;
+    }
+
+    template <uint32_t Live, unsigned N>
+    struct Parity
+    {
+        uint64_t const (*a)[N];
+        uint64_t (*c)[N];
+        template <unsigned X>
+        inline void step() const
+        {
+            for (unsigned k = 0; k < N; k++)
+                c[X][k] = live<Live, X, N>(a, k) ^ live<Live, X + 5, N>(a, k) ^
+                          live<Live, X + 10, N>(a, k) ^ live<Live, X + 15, N>(a, k) ^
+                          live<Live, X + 20, N>(a, k);
+        }
+    };
+
+    template <unsigned N>
+    struct Theta
+    {
+        uint64_t const (*c)[N];
+        uint64_t (*d)[N];
+        template <unsigned X>
+        inline void step() const
+        {
+            for (unsigned k = 0; k < N; k++)
+                d[X][k] = c[(X + 4) % 5][k] ^ rotl<1>(c[(X + 1) % 5][k]);
+        }
+    };
+
+    template <uint32_t Live, unsigned N>
+    struct RhoPi
+    {
+        uint64_t const (*a)[N];
+        uint64_t const (*d)[N];
+        uint64_t (*b)[N];
+        template <unsigned L>
+        inline void step() const
+        {
+            for (unsigned k = 0; k < N; k++)
+                b[L][k] = rotl<Spec::rho[Spec::pi[L]]>(
+                    live<Live, Spec::pi[L], N>(a, k) ^ d[Spec::pi[L] % 5][k]);
+        }
+    };
+
+    template <unsigned N>
+    struct Chi
+    {
+        uint64_t (*a)[N];
+        uint64_t const (*b)[N];
+        template <unsigned L>
+        inline void step() const
+        {
+            for (unsigned k = 0; k < N; k++)
+                a[L][k] = b[L][k] ^ (~b[L / 5 * 5 + (L + 1) % 5][k] & b[L / 5 * 5 + (L + 2) % 5][k]);
+        }
+    };
+
+    template <unsigned R, unsigned Out, uint32_t Live, unsigned N,
+        bool Last = (R + 1 == Spec::rounds)>
+    struct Rounds
+    {
+        static inline void run(uint64_t (*a)[N])
+        {
+            roundN<Live, Spec::lanes, N>(a, Spec::rc[R]);
+            Rounds<R + 1, Out, allLanes, N>::run(a);
+        }
+    };
+
+    template <unsigned R, unsigned Out, uint32_t Live, unsigned N>
+    struct Rounds<R, Out, Live, N, true>
+    {
+        static inline void run(uint64_t (*a)[N]) { roundN<Live, Out, N>(a, Spec::rc[R]); }
+    };
+};
+
+}  // namespace etc
+}  // namespace dev
@@ -26,6 +26,10 @@ unsigned Miner::s_dagLoadMode = 0;
 unsigned Miner::s_dagLoadIndex = 0;
 unsigned Miner::s_minersCount = 0;
 
+boost::mutex Miner::x_publish;
+std::shared_ptr<const WorkSnapshot> Miner::s_work;
+std::atomic<unsigned> Miner::s_workGen = {0};
+
 FarmFace* FarmFace::m_this = nullptr;
 
 DeviceDescriptor Miner::getDescriptor()
@@ -33,55 +37,36 @@ DeviceDescriptor Miner::getDescriptor()
     return m_deviceDescriptor;
 }
 
-void Miner::setWork(WorkPackage const& _work)
+void Miner::publishWork(std::shared_ptr<WorkSnapshot> _snapshot)
 {
-    {
-
-        boost::mutex::scoped_lock l(x_work);
-
-        // Void work if this miner is paused
-        if (paused())
-            m_work.header = h256();
-        else
-            m_work = _work;
-
-#ifdef DEV_BUILD
-        m_workSwitchStart = std::chrono::steady_clock::now();
-#endif
-    }
-
-    kick_miner();
+    // Generation is stamped and bumped in the same critical section, so
+    // two publishers can't stamp the same one
+    boost::mutex::scoped_lock l(x_publish);
+    const unsigned generation = s_workGen.load(std::memory_order_relaxed) + 1;
+    _snapshot->generation = generation;
+    _snapshot->published = std::chrono::steady_clock::now();
+
+    // Pointer first: a miner seeing the new generation and loading an older
+    // snapshot will find its generation behind and look again
+    std::atomic_store(&s_work, std::shared_ptr<const WorkSnapshot>(std::move(_snapshot)));
+    s_workGen.store(generation, std::memory_order_release);
 }
 
-void Miner::pause(MinerPauseEnum what) 
+void Miner::pause(MinerPauseEnum what)
 {
-    boost::mutex::scoped_lock l(x_pause);
-    m_pauseFlags.set(what);
-    m_work.header = h256();
+    m_pauseFlags.fetch_or(1u << what, std::memory_order_relaxed);
     kick_miner();
 }
 
-bool Miner::paused()
-{
-    boost::mutex::scoped_lock l(x_pause);
-    return m_pauseFlags.any();
-}
-
-bool Miner::pauseTest(MinerPauseEnum what)
-{
-    boost::mutex::scoped_lock l(x_pause);
-    return m_pauseFlags.test(what);
-}
-
 std::string Miner::pausedString()
 {
-    boost::mutex::scoped_lock l(x_pause);
+    unsigned flags = m_pauseFlags.load(std::memory_order_relaxed);
     std::string retVar;
-    if (m_pauseFlags.any())
+    if (flags)
     {
         for (int i = 0; i < MinerPauseEnum::Pause_MAX; i++)
         {
-            if (m_pauseFlags[(MinerPauseEnum)i])
+            if (flags & (1u << i))
             {
                 if (!retVar.empty())
                     retVar.append("; ");
@@ -103,41 +88,28 @@ std::string Miner::pausedString()
     return retVar;
 }
 
-void Miner::resume(MinerPauseEnum fromwhat) 
-{
-    boost::mutex::scoped_lock l(x_pause);
-    m_pauseFlags.reset(fromwhat);
-    //if (!m_pauseFlags.any())
-    //{
-    //    // TODO Push most recent job from farm ?
-    //    // If we do not push a new job the miner will stay idle
-    //    // till a new job arrives
-    //}
-}
-
-float Miner::RetrieveHashRate() noexcept
-{
-    return m_hashRate.load(std::memory_order_relaxed);
-}
-
-void Miner::TriggerHashRateUpdate() noexcept
+void Miner::resume(MinerPauseEnum fromwhat)
 {
-    bool b = false;
-    if (m_hashRateUpdate.compare_exchange_strong(b, true))
-        return;
-    // GPU didn't respond to last trigger, assume it's dead.
-    // This can happen on CUDA if:
-    //   runtime of --cuda-grid-size * --cuda-streams exceeds time of m_collectInterval
-    m_hashRate = 0.0;
+    unsigned flags;
+    {
+        // Under the lock waitForWork() sleeps with, so the wakeup can't be missed
+        boost::mutex::scoped_lock l(x_work);
+        flags = m_pauseFlags.fetch_and(~(1u << fromwhat), std::memory_order_relaxed) &
+                ~(1u << fromwhat);
+    }
+    // Last reason gone: resume the most recent job straight away
+    if (!flags)
+        m_new_work_signal.notify_all();
 }
 
 bool Miner::initEpoch()
 {
     // When loading of DAG is sequential wait for
     // this instance to become current
-    if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
+    const bool sequential = s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL && !m_dagLoadAlone;
+    if (sequential)
     {
-        while (s_dagLoadIndex < m_index)
+        while (s_dagLoadIndex < m_index && !shouldStop())
         {
             boost::system_time const timeout =
                 boost::get_system_time() + boost::posix_time::seconds(3);
@@ -154,7 +126,7 @@ bool Miner::initEpoch()
 
     // Advance to next miner or reset to zero for 
     // next run if all have processed
-    if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
+    if (sequential)
     {
         s_dagLoadIndex = (m_index + 1);
         if (s_minersCount == s_dagLoadIndex)
@@ -166,26 +138,108 @@ bool Miner::initEpoch()
     return result;
 }
 
-WorkPackage Miner::work() const
+void WorkSnapshot::split(
+    uint64_t _start, long double _space, size_t _slots, std::vector<RangeShare> const& _miners)
 {
-    boost::mutex::scoped_lock l(x_work);
+    // Miners whose search can't stop at a range end (GPU kernels deriving
+    // nonces from a fixed stream base) keep a fixed slice of space / miners.
+    // Out of what's left an eighth is held back and handed out on demand to
+    // miners running out of their range. The rest is split after measured
+    // hashrates so all ranges last about as long. Devices not measured yet
+    // still get a fair slice
+    uint64_t slice = (uint64_t)(_space / std::max(_miners.size(), (size_t)1));
+    uint64_t start = _start;
+    ranges.assign(_slots, NonceRange{_start, _start});
+    std::vector<long double> weights(_slots, 0);
+    size_t ranged = 0;
+    long double total = 0;
+    for (auto const& miner : _miners)
+    {
+        if (!miner.honoursRange)
+        {
+            ranges.at(miner.index) = NonceRange{start, start + slice};
+            start += slice;
+            continue;
+        }
+        weights.at(miner.index) = miner.hashrate;
+        total += miner.hashrate;
+        ranged++;
+    }
+    long double shared = _space - (long double)(start - _start);
+    uint64_t assigned = ranged ? (uint64_t)(shared - shared / 8) : 0;
+    long double least = total > 0 ? total / (16 * ranged) : 1;
+    total = 0;
+    for (auto const& miner : _miners)
+    {
+        if (!miner.honoursRange)
+            continue;
+        long double& weight = weights.at(miner.index);
+        weight = std::max(weight, least);
+        total += weight;
+    }
+
+    const uint64_t base = start;
+    long double cumulated = 0;
+    NonceRange* last = nullptr;
+    for (auto const& miner : _miners)
+    {
+        if (!miner.honoursRange)
+            continue;
+        last = &ranges.at(miner.index);
+        cumulated += weights.at(miner.index);
+        uint64_t end = base + (uint64_t)(assigned * (cumulated / total));
+        *last = NonceRange{start, end};
+        start = end;
+    }
+    if (last)
+        last->end = base + assigned;
+    spare = NonceRange{base + assigned, _start + (uint64_t)_space};
+    chunk = std::max(spare.size() / (8 * std::max(ranged, (size_t)1)), (uint64_t)1);
+}
+
+WorkPackage const& Miner::work()
+{
+    // Void work if this miner is paused
+    static const WorkPackage s_none;
+    if (paused())
+        return s_none;
+
+    if (workChanged())
+    {
+        std::shared_ptr<const WorkSnapshot> snapshot = std::atomic_load(&s_work);
+        if (snapshot)
+        {
+            m_snapshot = snapshot;
+            m_job = snapshot->job;
+            m_work = *m_job;
+            if (m_index < snapshot->ranges.size())
+                m_range = snapshot->ranges[m_index];
+            else if (!snapshot->claim(m_range))
+                m_range = NonceRange{m_work.startNonce, m_work.startNonce};
+            m_work.startNonce = m_range.start;
+            m_workGen = snapshot->generation;
+
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - snapshot->published)
+                          .count();
+            uint32_t latency = uint32_t(std::min<int64_t>(us, UINT32_MAX));
+            if (latency > m_switchLatency.load(std::memory_order_relaxed))
+                m_switchLatency.store(latency, std::memory_order_relaxed);
+#ifdef DEV_BUILD
+            m_workSwitchStart = snapshot->published;
+#endif
+        }
+    }
     return m_work;
 }
 
-void Miner::updateHashRate(uint32_t _groupSize, uint32_t _increment) noexcept
+void Miner::waitForWork()
 {
-    m_groupCount += _increment;
-    bool b = true;
-    if (!m_hashRateUpdate.compare_exchange_strong(b, false))
-        return;
-    using namespace std::chrono;
-    auto t = steady_clock::now();
-    auto us = duration_cast<microseconds>(t - m_hashTime).count();
-    m_hashTime = t;
-
-    m_hashRate.store(
-        us ? (float(m_groupCount * _groupSize) * 1.0e6f) / us : 0.0f, std::memory_order_relaxed);
-    m_groupCount = 0;
+    boost::system_time const timeout = boost::get_system_time() + boost::posix_time::seconds(3);
+    boost::mutex::scoped_lock l(x_work);
+    while (!shouldStop() && (paused() || (!workChanged() && !m_work)))
+        if (!m_new_work_signal.timed_wait(l, timeout))
+            break;
 }
 
 
@@ -17,12 +17,16 @@
 
 #pragma once
 
-#include <bitset>
+#include <algorithm>
+#include <atomic>
 #include <list>
+#include <memory>
 #include <numeric>
 #include <string>
+#include <vector>
 
 #include "KeccakAux.h"
+#include "NonceLedger.h"
 #include <libdevcore/Common.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/Worker.h>
@@ -64,6 +68,14 @@ enum class MinerType
     CPU
 };
 
+enum class CpuPolicyEnum
+{
+    Logical,  // One thread per allowed logical CPU
+    Core,     // One thread per physical core (SMT siblings left idle)
+    Numa,     // One thread per allowed logical CPU floating within its NUMA node
+    List      // One thread per logical CPU given in CPSettings::cpus
+};
+
 enum class HwMonitorInfoType
 {
     UNKNOWN,
@@ -116,6 +128,15 @@ struct CLSettings : public MinerSettings
 // Holds settings for CPU Miner
 struct CPSettings : public MinerSettings
 {
+    CpuPolicyEnum policy = CpuPolicyEnum::Logical;
+    vector<unsigned> cpus;   // Logical CPU ids for CpuPolicyEnum::List
+    bool pool = false;       // One device backed by a thread per placement
+    unsigned latency = 500;  // Job switch latency target in microseconds
+    bool idle = false;       // Hash threads run under SCHED_IDLE
+    int nice = 0;            // Nice level of hash threads
+    unsigned share = 100;    // CPU share (percent) each hash thread may use
+    unsigned pressure = 0;   // CPU pressure (percent) above which share backs off. 0 = never
+    bool counters = false;   // Sample hardware performance counters of hash threads
 };
 
 struct SolutionAccountType
@@ -152,12 +173,42 @@ struct HwSensorsType
     };
 };
 
+// Hardware performance counters of the hashing threads over last collection interval
+struct HwCountersType
+{
+    bool valid = false;          // Whether or not the miner samples counters
+    double cyclesPerHash = 0.0;  // Core cycles spent per hash
+    double ipc = 0.0;            // Instructions per cycle
+    double mhz = 0.0;            // Average clock while hashing (cycles / task time)
+    double stalled = 0.0;        // Fraction of cycles stalled in backend. Negative if unknown
+    string str()
+    {
+        if (!valid)
+            return string();
+        string _ret = boost::str(boost::format("%0.0fc/h %0.2fIPC %0.0fMHz") % cyclesPerHash % ipc %
+                                 mhz);
+        if (stalled >= 0.0)
+            _ret.append(" " + boost::str(boost::format("%0.0f%%") % (stalled * 100.0)) + "stall");
+        return _ret;
+    };
+};
+
+// Hash rates in hashes per second over 10 seconds, 1 minute and 15 minutes
+struct HashRateType
+{
+    float ewma[3] = {0.0f, 0.0f, 0.0f};    // Exponentially weighted moving averages
+    float window[3] = {0.0f, 0.0f, 0.0f};  // Plain averages over the whole window
+};
+
 struct TelemetryAccountType
 {
     string prefix = "";
-    float hashrate = 0.0f;
+    float hashrate = 0.0f;  // 1 minute moving average
+    HashRateType rates;
     bool paused = false;
+    bool removed = false;  // Device is gone. Slot is kept so that indexes don't move
     HwSensorsType sensors;
+    HwCountersType counters;
     SolutionAccountType solutions;
 };
 
@@ -199,7 +250,10 @@ struct DeviceDescriptor
     unsigned int cuComputeMajor;
     unsigned int cuComputeMinor;
 
-    int cpCpuNumer;   // For CPU
+    int cpCpuNumer;               // For CPU
+    unsigned cpCore = 0;          // Physical core (unique across packages)
+    unsigned cpNode = 0;          // NUMA node
+    vector<unsigned> cpAffinity;  // Logical CPUs the miner thread may run on
 };
 
 struct HwMonitorInfo
@@ -280,11 +334,19 @@ struct TelemetryType
         _ret << EthTealBold << std::fixed << std::setprecision(2) << hr << " "
              << suffixes[magnitude] << EthReset << " - ";
 
-        int i = -1;                 // Current miner index
-        int m = miners.size() - 1;  // Max miner index
+        int i = -1;  // Current miner index
+        bool first = true;
         for (TelemetryAccountType miner : miners)
         {
             i++;
+            if (miner.removed)
+                continue;
+
+            // Separator if not the first miner shown
+            if (!first)
+                _ret << ", ";
+            first = false;
+
             hr = miner.hashrate;
             if (hr > 0.0f)
                 hr /= pow(1000.0f, magnitude);
@@ -295,13 +357,12 @@ struct TelemetryType
             if (hwmon)
                 _ret << " " << EthTeal << miner.sensors.str() << EthReset;
 
+            if (miner.counters.valid)
+                _ret << " " << EthTeal << miner.counters.str() << EthReset;
+
             // Eventually push also solutions per single GPU
             if (g_logOptions & LOG_PER_GPU)
                 _ret << " " << EthTeal << miner.solutions.str() << EthReset;
-
-            // Separator if not the last miner index
-            if (i < m)
-                _ret << ", ";
         }
 
         return _ret.str();
@@ -309,6 +370,59 @@ struct TelemetryType
 };
 
 
+/**
+ * @brief What a miner brings to the split of a job's nonce space
+ */
+struct RangeShare
+{
+    unsigned index;
+    bool honoursRange;
+    float hashrate;
+};
+
+/**
+ * @brief Immutable job published once by the farm for all its miners.
+ * Each miner starts on its own range, sized after its hashrate. Miners
+ * running out of it claim follow-up chunks of the spare range. Miners
+ * which can't honour a range end get a fixed slice instead
+ */
+struct WorkSnapshot
+{
+    std::shared_ptr<const WorkPackage> job;
+    std::vector<NonceRange> ranges;       // Initial range of miner i
+    NonceRange spare = {0, 0};            // Held back for miners running dry
+    uint64_t chunk = 1;                   // Spare nonces handed out at once
+    std::shared_ptr<NonceLedger> ledger;  // Nonces of the job already scanned
+    mutable std::atomic<uint64_t> spareClaimed = {0};
+    unsigned generation = 0;
+    std::chrono::steady_clock::time_point published;
+
+    /**
+     * @brief Splits _space nonces from _start among _miners into ranges,
+     * spare and chunk. Ranges go by miner's index, _slots of them
+     */
+    void split(
+        uint64_t _start, long double _space, size_t _slots, std::vector<RangeShare> const& _miners);
+
+    /**
+     * @brief Claims the next chunk of spare nonces
+     * @return false once they are all handed out
+     * @threadsafe
+     */
+    bool claim(NonceRange& _range) const
+    {
+        uint64_t size = spare.size();
+        if (spareClaimed.load(std::memory_order_relaxed) >= size)
+            return false;
+        uint64_t offset = spareClaimed.fetch_add(chunk, std::memory_order_relaxed);
+        if (offset >= size)
+            return false;
+        _range.start = spare.start + offset;
+        _range.end = spare.start + std::min(offset + chunk, size);
+        return true;
+    }
+};
+
 /**
  * @brief Class for hosting one or more Miners.
  * @warning Must be implemented in a threadsafe manner since it will be called from multiple
@@ -361,15 +475,35 @@ public:
         s_minersCount = _devicecount;
     };
 
+    /**
+     * @brief Keeps this miner out of sequential DAG load : it loads on its
+     * own on every epoch change. For miners joining a running farm, whose
+     * sequence doesn't account for them. Call before startWorking()
+     */
+    void skipDagLoadSequence() { m_dagLoadAlone = true; }
+
     /**
      * @brief Gets the device descriptor assigned to this instance
      */
     DeviceDescriptor getDescriptor();
 
     /**
-     * @brief Assigns hashing work to this instance
+     * @brief Publishes hashing work to all instances.
+     * Swaps in a new snapshot and bumps the generation: never waits on miners.
+     * Publishers are serialized by a mutex. Miners only read the generation
+     * (a relaxed atomic load) while the job stays the same : the snapshot
+     * is loaded, through std::atomic_load, on job change only
+     * @threadsafe
      */
-    void setWork(WorkPackage const& _work);
+    static void publishWork(std::shared_ptr<WorkSnapshot> _snapshot);
+
+    /**
+     * @brief Generation of the most recently published work
+     */
+    static unsigned workGeneration() noexcept
+    {
+        return s_workGen.load(std::memory_order_relaxed);
+    }
 
     /**
      * @brief Assigns Epoch context to this instance
@@ -393,14 +527,18 @@ public:
     void pause(MinerPauseEnum what);
 
     /**
-     * @brief Whether or not this miner is paused for any reason
+     * @brief Whether or not this miner is paused for any reason.
+     * A single relaxed load: cheap enough for hash loops
      */
-    bool paused();
+    bool paused() const noexcept { return m_pauseFlags.load(std::memory_order_relaxed) != 0; }
 
     /**
      * @brief Checks if the given reason for pausing is currently active
      */
-    bool pauseTest(MinerPauseEnum what);
+    bool pauseTest(MinerPauseEnum what) const noexcept
+    {
+        return (m_pauseFlags.load(std::memory_order_relaxed) & (1u << what)) != 0;
+    }
 
     /**
      * @brief Returns the human readable reason for this miner being paused
@@ -408,17 +546,51 @@ public:
     std::string pausedString();
 
     /**
-     * @brief Cancels a pause flag.
+     * @brief Cancels a pause flag. Wakes the miner when no flag is left
      * @note Miner can be paused for multiple reasons at a time.
      */
     void resume(MinerPauseEnum fromwhat);
 
     /**
-     * @brief Retrieves currrently collected hashrate
+     * @brief Retrieves hashrate last published by the farm
+     */
+    float RetrieveHashRate() const noexcept { return m_hashRate.load(std::memory_order_relaxed); }
+
+    void publishHashRate(float _rate) noexcept
+    {
+        m_hashRate.store(_rate, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Retrieves the number of hashes computed since miner's creation.
+     * Never decreases
+     */
+    uint64_t RetrieveHashCount() const noexcept
+    {
+        return m_hashCount.value.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Retrieves the longest delay, in microseconds, between publication of
+     * a job and this miner picking it up since previous call. 0 if none
+     */
+    uint32_t RetrieveSwitchLatency() noexcept
+    {
+        return m_switchLatency.exchange(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Whether or not search stays within workRange() and claims
+     * follow-up chunks from workSnapshot(). Other miners are given a fixed
+     * slice of the job's nonce space
      */
-    float RetrieveHashRate() noexcept;
+    virtual bool honoursRange() const { return false; }
 
-    void TriggerHashRateUpdate() noexcept;
+    /**
+     * @brief Retrieves hardware counters sampled since previous call.
+     * Miners which don't sample any return them invalid
+     */
+    virtual HwCountersType RetrieveCounters() { return HwCountersType(); }
 
 protected:
     /**
@@ -437,11 +609,49 @@ protected:
     virtual bool initEpoch_internal() = 0;
 
     /**
-     * @brief Returns current workpackage this miner is working on
+     * @brief Returns current workpackage this miner is working on.
+     * Only refreshed from the published snapshot when its generation moved.
+     * Must be called from the miner's own thread
      */
-    WorkPackage work() const;
+    WorkPackage const& work();
 
-    void updateHashRate(uint32_t _groupSize, uint32_t _increment) noexcept;
+    /**
+     * @brief Immutable job work() was derived from. Solutions found
+     * on it share it rather than copying it
+     */
+    std::shared_ptr<const WorkPackage> const& workJob() const { return m_job; }
+
+    /**
+     * @brief Snapshot work() was derived from. Follow-up ranges are claimed from it
+     */
+    std::shared_ptr<const WorkSnapshot> const& workSnapshot() const { return m_snapshot; }
+
+    /**
+     * @brief Nonce range work() starts at. Searching past its end would
+     * overlap another miner: claim a follow-up one from workSnapshot()
+     */
+    NonceRange const& workRange() const { return m_range; }
+
+    /**
+     * @brief Whether or not work has been published since last call to work()
+     */
+    bool workChanged() const noexcept { return workGeneration() != m_workGen; }
+
+    /**
+     * @brief Sleeps until there is work to do: not paused and work available.
+     * Returns earlier on stop request or after 3 seconds
+     */
+    void waitForWork();
+
+    /**
+     * @brief Adds _groupSize * _increment hashes to the counter.
+     * May be called by every hash thread of the miner
+     * @threadsafe
+     */
+    void updateHashRate(uint32_t _groupSize, uint32_t _increment) noexcept
+    {
+        m_hashCount.value.fetch_add(uint64_t(_groupSize) * _increment, std::memory_order_relaxed);
+    }
 
     static unsigned s_minersCount;   // Total Number of Miners
     static unsigned s_dagLoadMode;   // Way dag should be loaded
@@ -459,19 +669,35 @@ protected:
 
     HwMonitorInfo m_hwmoninfo;
     mutable boost::mutex x_work;
-    mutable boost::mutex x_pause;
     boost::condition_variable m_new_work_signal;
     boost::condition_variable m_dag_loaded_signal;
 
 private:
-    bitset<MinerPauseEnum::Pause_MAX> m_pauseFlags;
-
-    WorkPackage m_work;
+    static_assert(MinerPauseEnum::Pause_MAX <= 32, "Pause reasons must fit the flags mask");
+    std::atomic<unsigned> m_pauseFlags = {0};  // Bit i set when paused for reason i
+    bool m_dagLoadAlone = false;               // Out of sequential DAG load
+
+    static boost::mutex x_publish;                       // Serializes publishers
+    static std::shared_ptr<const WorkSnapshot> s_work;  // Accessed with std::atomic_load/store
+    static std::atomic<unsigned> s_workGen;
+
+    std::shared_ptr<const WorkSnapshot> m_snapshot;  // Snapshot m_work was built from
+    std::shared_ptr<const WorkPackage> m_job;
+    WorkPackage m_work;           // This miner's copy of the job with its own start nonce
+    NonceRange m_range = {0, 0};  // This miner's initial range
+    unsigned m_workGen = 0;       // Generation m_work was built from
+
+    // Alone on its cache line, so that the collector reading it and
+    // neighbouring fields being written don't slow down the miner
+    struct PaddedCounter
+    {
+        char before[64];
+        std::atomic<uint64_t> value = {0};
+        char after[64 - sizeof(std::atomic<uint64_t>)];
+    } m_hashCount;
 
-    std::chrono::steady_clock::time_point m_hashTime = std::chrono::steady_clock::now();
     std::atomic<float> m_hashRate = {0.0};
-    uint64_t m_groupCount = 0;
-    atomic<bool> m_hashRateUpdate = {false};
+    std::atomic<uint32_t> m_switchLatency = {0};
 };
 
 }  // namespace etc
@@ -0,0 +1,202 @@
+/*
+ This file is part of keccakminer.
+
+ keccakminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ keccakminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "NonceLedger.h"
+
+namespace dev
+{
+namespace etc
+{
+namespace
+{
+const uint64_t c_lastNonce = ~0ULL;
+const std::chrono::seconds c_viewFlush(1);
+
+NonceRange uncoveredIn(std::map<uint64_t, uint64_t> const& _intervals, NonceRange const& _range)
+{
+    uint64_t nonce = _range.start;
+    uint64_t left = _range.size();
+    while (left)
+    {
+        auto it = _intervals.upper_bound(nonce);
+        if (it != _intervals.begin() && std::prev(it)->second >= nonce)
+        {
+            // Skip the interval holding nonce. 0 stands for 2^64
+            uint64_t skip = std::prev(it)->second - nonce + 1;
+            if (!skip || skip >= left)
+                break;
+            nonce += skip;
+            left -= skip;
+            continue;
+        }
+
+        // Gap up to next interval or up to 2^64
+        uint64_t gap = it != _intervals.end() ? it->first - nonce : 0 - nonce;
+        if (!gap || gap > left)
+            gap = left;
+        return NonceRange{nonce, nonce + gap};
+    }
+    return NonceRange{_range.end, _range.end};
+}
+
+}  // namespace
+
+void NonceLedger::add(uint64_t _start, uint64_t _count)
+{
+    if (!_count)
+        return;
+
+    Guard l(x_ledger);
+    uint64_t last = _start + _count - 1;
+    if (last < _start)
+    {
+        // Wraps past 2^64
+        addInterval(_start, c_lastNonce);
+        addInterval(0, last);
+    }
+    else
+        addInterval(_start, last);
+    m_dirty.store(true, std::memory_order_relaxed);
+}
+
+void NonceLedger::addInterval(uint64_t _first, uint64_t _last)
+{
+    // Merge with overlapping or adjacent intervals
+    auto it = m_intervals.upper_bound(_first);
+    if (it != m_intervals.begin())
+    {
+        auto prev = std::prev(it);
+        if (prev->second == c_lastNonce || prev->second + 1 >= _first)
+        {
+            _first = prev->first;
+            _last = std::max(_last, prev->second);
+            it = m_intervals.erase(prev);
+        }
+    }
+    while (it != m_intervals.end() && (_last == c_lastNonce || it->first <= _last + 1))
+    {
+        _last = std::max(_last, it->second);
+        it = m_intervals.erase(it);
+    }
+    m_intervals[_first] = _last;
+}
+
+NonceRange NonceLedger::uncovered(NonceRange const& _range) const
+{
+    Guard l(x_ledger);
+    return uncoveredIn(m_intervals, _range);
+}
+
+uint64_t NonceLedger::covered() const
+{
+    Guard l(x_ledger);
+    uint64_t count = 0;
+    for (auto const& interval : m_intervals)
+    {
+        // The whole 2^64 space doesn't fit : saturate
+        uint64_t size = interval.second - interval.first + 1;
+        if (!size || count + size < count)
+            return c_lastNonce;
+        count += size;
+    }
+    return count;
+}
+
+bool NonceLedger::save(std::string const& _file)
+{
+    // Nonces added while writing are saved next time
+    m_dirty.store(false, std::memory_order_relaxed);
+
+    std::string tmp = _file + ".tmp";
+    bool ok;
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        Guard l(x_ledger);
+        f << m_header.hex() << "\n" << std::hex << m_base << "\n";
+        for (auto const& interval : m_intervals)
+            f << interval.first << " " << interval.second << "\n";
+        ok = f.good();
+    }
+    if (ok && std::rename(tmp.c_str(), _file.c_str()) == 0)
+        return true;
+
+    m_dirty.store(true, std::memory_order_relaxed);
+    return false;
+}
+
+std::shared_ptr<NonceLedger> NonceLedger::load(std::string const& _file)
+{
+    std::ifstream f(_file);
+    std::string header;
+    uint64_t base;
+    if (!(f >> header >> std::hex >> base) || header.size() != 64)
+        return nullptr;
+
+    std::shared_ptr<NonceLedger> ledger;
+    try
+    {
+        ledger = std::make_shared<NonceLedger>(h256(header), base);
+    }
+    catch (std::exception const&)
+    {
+        return nullptr;
+    }
+
+    uint64_t first, last;
+    while (f >> first >> last)
+        if (first <= last)
+            ledger->addInterval(first, last);
+    return ledger;
+}
+
+NonceLedgerView::NonceLedgerView(NonceLedger& _ledger)
+  : m_ledger(_ledger), m_flushed(std::chrono::steady_clock::now())
+{
+    Guard l(_ledger.x_ledger);
+    m_prior = _ledger.m_intervals;
+}
+
+NonceRange NonceLedgerView::uncovered(NonceRange const& _range) const
+{
+    return uncoveredIn(m_prior, _range);
+}
+
+void NonceLedgerView::add(uint64_t _start, uint64_t _count)
+{
+    if (m_count && m_start + m_count != _start)
+        flush();
+    if (!m_count)
+        m_start = _start;
+    m_count += _count;
+    if (std::chrono::steady_clock::now() - m_flushed >= c_viewFlush)
+        flush();
+}
+
+void NonceLedgerView::flush()
+{
+    m_ledger.add(m_start, m_count);
+    m_count = 0;
+    m_flushed = std::chrono::steady_clock::now();
+}
+
+}  // namespace etc
+}  // namespace dev
@@ -0,0 +1,146 @@
+/*
+ This file is part of keccakminer.
+
+ keccakminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ keccakminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace etc
+{
+/**
+ * @brief Nonces from start (included) to end (excluded), modulo 2^64
+ */
+struct NonceRange
+{
+    uint64_t start;
+    uint64_t end;
+
+    uint64_t size() const { return end - start; }
+};
+
+/**
+ * @brief Nonces of a job already scanned, as a set of disjoint intervals.
+ * Lets miners resume where coverage ends after a pause or a restart
+ * instead of hashing the same nonces again
+ * @threadsafe
+ */
+class NonceLedger
+{
+public:
+    NonceLedger(h256 const& _header, uint64_t _base) : m_header(_header), m_base(_base) {}
+
+    h256 const& header() const { return m_header; }
+
+    /**
+     * @brief Start nonce of the job the coverage was recorded on
+     */
+    uint64_t base() const { return m_base; }
+
+    /**
+     * @brief Records _count nonces from _start (wrapping past 2^64) as scanned
+     */
+    void add(uint64_t _start, uint64_t _count);
+
+    /**
+     * @brief First nonces of _range not scanned yet.
+     * An empty range at _range.end when there are none
+     */
+    NonceRange uncovered(NonceRange const& _range) const;
+
+    /**
+     * @brief Number of nonces scanned, saturated at 2^64 - 1
+     */
+    uint64_t covered() const;
+
+    /**
+     * @brief Whether or not nonces were added since last save
+     */
+    bool dirty() const { return m_dirty.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Writes the ledger to _file, atomically replacing it
+     */
+    bool save(std::string const& _file);
+
+    /**
+     * @brief Reads a ledger saved by save()
+     * @return nullptr if there is none or it can't be read
+     */
+    static std::shared_ptr<NonceLedger> load(std::string const& _file);
+
+private:
+    friend class NonceLedgerView;
+
+    void addInterval(uint64_t _first, uint64_t _last);
+
+    mutable Mutex x_ledger;
+    h256 m_header;
+    uint64_t m_base;
+    std::map<uint64_t, uint64_t> m_intervals;  // First to last scanned nonce, both included
+    std::atomic<bool> m_dirty = {false};
+};
+
+/**
+ * @brief A hash thread's view of a ledger. Nonces scanned before the view
+ * was taken are looked up in a private copy and those the thread scans are
+ * handed to the ledger at most once a second, so hash threads don't take
+ * the ledger's mutex every batch. Threads must scan disjoint nonces, as
+ * ranges and chunks of a job are
+ */
+class NonceLedgerView
+{
+public:
+    explicit NonceLedgerView(NonceLedger& _ledger);
+    NonceLedgerView(NonceLedgerView const&) = delete;
+    NonceLedgerView& operator=(NonceLedgerView const&) = delete;
+    ~NonceLedgerView() { flush(); }
+
+    /**
+     * @brief Same as NonceLedger::uncovered() as of when the view was taken
+     */
+    NonceRange uncovered(NonceRange const& _range) const;
+
+    /**
+     * @brief Records _count nonces from _start as scanned. Reaches the
+     * ledger on next flush
+     */
+    void add(uint64_t _start, uint64_t _count);
+
+    /**
+     * @brief Hands pending nonces to the ledger. Also done on destruction
+     */
+    void flush();
+
+private:
+    NonceLedger& m_ledger;
+    std::map<uint64_t, uint64_t> m_prior;  // Ledger's intervals when the view was taken
+    uint64_t m_start = 0;                  // Pending nonces, contiguous
+    uint64_t m_count = 0;
+    std::chrono::steady_clock::time_point m_flushed;
+};
+
+}  // namespace etc
+}  // namespace dev
@@ -0,0 +1,156 @@
+/*
+ This file is part of keccakminer.
+
+ keccakminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ keccakminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <memory>
+
+#include "HashRateMeter.h"
+#include "Miner.h"
+#include "NonceLedger.h"
+#include "SelfTest.h"
+#include "ShareFilter.h"
+
+using namespace std::chrono;
+
+namespace dev
+{
+namespace etc
+{
+namespace
+{
+bool same(NonceRange const& _a, NonceRange const& _b)
+{
+    return _a.start == _b.start && _a.end == _b.end;
+}
+
+// Merging, gaps, wrapping past 2^64, saturation and views
+bool ledgerSelfTest()
+{
+    NonceLedger ledger(h256(), 0);
+    ledger.add(10, 10);
+    ledger.add(30, 5);
+    ledger.add(20, 10);  // Joins both neighbours
+    if (ledger.covered() != 25 || !same(ledger.uncovered({0, 100}), {0, 10}) ||
+        !same(ledger.uncovered({10, 100}), {35, 100}) ||
+        !same(ledger.uncovered({12, 30}), {30, 30}))
+        return false;
+
+    const uint64_t top = ~0ULL - 4;
+    ledger.add(top, 10);  // Last 5 nonces and first 5
+    if (ledger.covered() != 35 || !same(ledger.uncovered({top - 6, 20}), {top - 6, top}) ||
+        !same(ledger.uncovered({top, 20}), {5, 10}))
+        return false;
+
+    NonceLedger full(h256(), 0);
+    full.add(1, ~0ULL);
+    full.add(0, 1);
+    if (full.covered() != ~0ULL || full.uncovered({0, 0 - 1ULL}).size())
+        return false;
+
+    // Pending nonces reach the ledger on flush only. A view keeps
+    // answering as of when it was taken
+    NonceLedgerView view(ledger);
+    view.add(40, 5);
+    view.add(45, 5);
+    view.flush();
+    return same(ledger.uncovered({35, 100}), {35, 40}) &&
+           same(ledger.uncovered({40, 100}), {50, 100}) &&
+           same(view.uncovered({35, 100}), {35, 100});
+}
+
+// A new pair is never a duplicate, even once eviction started, and the
+// latest one is remembered
+bool shareFilterSelfTest()
+{
+    std::unique_ptr<ShareFilter> filter(new ShareFilter());
+    h256 header;
+    header[0] = 0x5a;
+    if (!filter->insert(header, 1) || filter->insert(header, 1))
+        return false;
+    for (uint64_t nonce = 2; nonce < 3 * 4096; nonce++)
+        if (!filter->insert(header, nonce))
+            return false;
+    header[31] = 1;
+    return filter->insert(header, 1) && !filter->insert(header, 1);
+}
+
+// Fixed slice for a miner which can't honour a range, the rest after
+// hashrates, an eighth held back, no overlap. Space wraps past 2^64
+bool splitSelfTest()
+{
+    const uint64_t start = ~0ULL - 999;
+    const long double space = 4000;
+    WorkSnapshot snapshot;
+    snapshot.split(start, space, 4, {{0, false, 0.0f}, {2, true, 300.0f}, {3, true, 100.0f}});
+
+    auto const& r = snapshot.ranges;
+    if (r.size() != 4 || !same(r[0], {start, start + 1333}) || r[1].size() ||
+        r[2].start != r[0].end || r[3].start != r[2].end || r[3].end != snapshot.spare.start ||
+        !same(snapshot.spare, {start + 3666, start + 4000}))
+        return false;
+    if (r[2].size() < 3 * r[3].size() - 3 || r[2].size() > 3 * r[3].size() + 3)
+        return false;
+
+    // Spare is handed out in chunks, each nonce once
+    NonceRange chunk = {0, 0};
+    uint64_t next = snapshot.spare.start;
+    while (snapshot.claim(chunk))
+    {
+        if (chunk.start != next || !chunk.size())
+            return false;
+        next = chunk.end;
+    }
+    return next == snapshot.spare.end;
+}
+
+// First delta seeds the averages, a counter going back restarts the meter
+bool meterSelfTest()
+{
+    HashRateMeter meter;
+    auto t0 = steady_clock::now();
+    if (meter.sample(0, t0) != 0 || meter.sample(1000, t0 + seconds(1)) != 1000)
+        return false;
+    for (unsigned i = 0; i < 3; i++)
+        if (std::fabs(meter.rates().ewma[i] - 1000.0f) > 0.5f ||
+            std::fabs(meter.rates().window[i] - 1000.0f) > 0.5f)
+            return false;
+
+    meter.sample(3000, t0 + seconds(2));
+    float ewma = meter.rates().ewma[0];
+    if (std::fabs(meter.rates().window[0] - 1500.0f) > 0.5f || ewma <= 1000.0f || ewma >= 2000.0f)
+        return false;
+
+    return meter.sample(10, t0 + seconds(3)) == 0 && meter.rates().ewma[0] == 0.0f;
+}
+
+}  // namespace
+
+char const* farmSelfTest()
+{
+    if (!ledgerSelfTest())
+        return "nonce ledger";
+    if (!shareFilterSelfTest())
+        return "share filter";
+    if (!splitSelfTest())
+        return "nonce space split";
+    if (!meterSelfTest())
+        return "hash rate meter";
+    return nullptr;
+}
+
+}  // namespace etc
+}  // namespace dev
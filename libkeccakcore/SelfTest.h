@@ -0,0 +1,33 @@
+/*
+ This file is part of keccakminer.
+
+ keccakminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ keccakminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+namespace dev
+{
+namespace etc
+{
+/**
+ * @brief Checks the farm's bookkeeping on known cases : nonce ledger
+ * intervals, share filter eviction, nonce space split among miners and
+ * hash rate averages. Takes well under a millisecond
+ * @return name of the first failing check, nullptr when all pass
+ */
+char const* farmSelfTest();
+
+}  // namespace etc
+}  // namespace dev
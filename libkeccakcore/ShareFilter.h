@@ -0,0 +1,104 @@
+/*
+ This file is part of keccakminer.
+
+ keccakminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ keccakminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include <libdevcore/FixedHash.h>
+
+namespace dev
+{
+namespace etc
+{
+/**
+ * @brief Fixed memory set of recently submitted (job, nonce) pairs.
+ * Open addressing over 64 bits fingerprints, inserted with a single CAS.
+ * When all probed slots are taken the oldest guess is overwritten, so a
+ * long forgotten pair may pass again but a new pair is never reported as
+ * a duplicate (short of a 64 bits fingerprint collision)
+ * @threadsafe
+ */
+class ShareFilter
+{
+public:
+    ShareFilter()
+    {
+        for (auto& slot : m_slots)
+            slot.store(0, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Records the pair
+     * @return false if it was already recorded
+     */
+    bool insert(h256 const& _header, uint64_t _nonce)
+    {
+        uint64_t key = fingerprint(_header, _nonce);
+        for (unsigned i = 0; i < c_probes; i++)
+        {
+            std::atomic<uint64_t>& slot = m_slots[(key + i) & (c_slots - 1)];
+            uint64_t current = slot.load(std::memory_order_relaxed);
+            if (current == key)
+                return false;
+            if (current == 0)
+            {
+                if (slot.compare_exchange_strong(current, key, std::memory_order_relaxed))
+                    return true;
+                if (current == key)
+                    return false;
+            }
+        }
+
+        // Neighbourhood full : evict, rotating over the probed slots
+        unsigned victim = m_evict.fetch_add(1, std::memory_order_relaxed) % c_probes;
+        m_slots[(key + victim) & (c_slots - 1)].store(key, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    static const unsigned c_slots = 4096;  // Power of 2. 32 KiB
+    static const unsigned c_probes = 16;
+
+    // Never 0, which marks a free slot
+    static uint64_t fingerprint(h256 const& _header, uint64_t _nonce)
+    {
+        uint64_t x = _nonce;
+        for (unsigned i = 0; i < 32; i += 8)
+        {
+            uint64_t lane = 0;
+            for (unsigned j = 0; j < 8; j++)
+                lane = (lane << 8) | _header[i + j];
+            x = mix(x ^ lane);
+        }
+        return x ? x : 1;
+    }
+
+    // splitmix64 finalizer
+    static uint64_t mix(uint64_t _x)
+    {
+        _x = (_x ^ (_x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        _x = (_x ^ (_x >> 27)) * 0x94d049bb133111ebULL;
+        return _x ^ (_x >> 31);
+    }
+
+    std::atomic<uint64_t> m_slots[c_slots];
+    std::atomic<unsigned> m_evict = {0};
+};
+
+}  // namespace etc
+}  // namespace dev
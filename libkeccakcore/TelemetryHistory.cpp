@@ -0,0 +1,163 @@
+/*
+ This file is part of keccakminer.
+
+ keccakminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ keccakminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+#include "TelemetryHistory.h"
+
+namespace dev
+{
+namespace etc
+{
+namespace
+{
+const unsigned c_maxPeriods = 1000000;  // Per tier
+}
+
+TelemetryHistory::TelemetryHistory(std::vector<TelemetryTier> const& _tiers)
+{
+    for (auto const& t : _tiers)
+    {
+        Tier tier;
+        tier.resolution = t.resolution;
+        tier.ring.resize(t.retention / t.resolution);
+        tier.perPeriod = t.resolution / _tiers.front().resolution;
+        m_tiers.push_back(std::move(tier));
+    }
+}
+
+std::vector<TelemetryTier> TelemetryHistory::parse(std::string const& _spec)
+{
+    std::vector<TelemetryTier> tiers;
+    if (_spec.empty() || _spec == "off")
+        return tiers;
+
+    std::istringstream ss(_spec);
+    std::string item;
+    while (std::getline(ss, item, ','))
+    {
+        TelemetryTier tier;
+        char colon = 0;
+        std::istringstream is(item);
+        if (!(is >> tier.resolution >> colon >> tier.retention) || colon != ':' || !is.eof())
+            throw std::invalid_argument("Expected resolution:retention, got '" + item + "'");
+        if (!tier.resolution || tier.retention < tier.resolution ||
+            tier.retention % tier.resolution)
+            throw std::invalid_argument(
+                "Retention must be a non zero multiple of resolution in '" + item + "'");
+        if (tier.retention / tier.resolution > c_maxPeriods)
+            throw std::invalid_argument("Too many periods in '" + item + "'");
+        if (!tiers.empty() && (tier.resolution <= tiers.back().resolution ||
+                                  tier.resolution % tiers.back().resolution))
+            throw std::invalid_argument(
+                "Resolution must be a multiple of previous one in '" + item + "'");
+        tiers.push_back(tier);
+    }
+    return tiers;
+}
+
+unsigned TelemetryHistory::resolution() const
+{
+    return m_tiers.empty() ? 0 : m_tiers.front().resolution;
+}
+
+void TelemetryHistory::record(uint64_t _time, std::vector<TelemetrySample> const& _samples)
+{
+    Guard l(x_history);
+    for (auto& tier : m_tiers)
+    {
+        uint64_t index = _time / tier.resolution;
+        if (tier.records && tier.pending.index != index)
+            close(tier);
+
+        Period& p = tier.pending;
+        p.index = index;
+        if (p.samples.size() < _samples.size())
+            p.samples.resize(_samples.size());
+        for (size_t i = 0; i < _samples.size(); i++)
+        {
+            TelemetrySample& acc = p.samples[i];
+            TelemetrySample const& s = _samples[i];
+            acc.hashrate += s.hashrate;
+            acc.accepted += s.accepted;
+            acc.rejected += s.rejected;
+            acc.failed += s.failed;
+            acc.tempC += s.tempC;
+            acc.fanP += s.fanP;
+            acc.powerW += s.powerW;
+            acc.switchMs = std::max(acc.switchMs, s.switchMs);
+        }
+        if (++tier.records == tier.perPeriod)
+            close(tier);
+    }
+}
+
+void TelemetryHistory::close(Tier& _tier)
+{
+    // Sums of rates and sensors to averages
+    float n = float(_tier.records);
+    for (auto& s : _tier.pending.samples)
+    {
+        s.hashrate /= n;
+        s.tempC /= n;
+        s.fanP /= n;
+        s.powerW /= n;
+    }
+
+    _tier.newest = _tier.pending.index;
+    _tier.ring[_tier.newest % _tier.ring.size()] = std::move(_tier.pending);
+    _tier.pending = Period();
+    _tier.records = 0;
+}
+
+TelemetrySeries TelemetryHistory::query(
+    uint64_t _from, uint64_t _to, unsigned _resolution, unsigned _max) const
+{
+    TelemetrySeries series;
+    Guard l(x_history);
+    if (m_tiers.empty())
+        return series;
+
+    // Finest tier matching the request, else the coarsest one
+    auto tier = m_tiers.begin();
+    for (; tier + 1 != m_tiers.end(); tier++)
+        if (_resolution ? tier->resolution >= _resolution :
+                          _from / tier->resolution + tier->ring.size() > tier->newest)
+            break;
+
+    uint64_t first = _from / tier->resolution;
+    uint64_t last = (_to + tier->resolution - 1) / tier->resolution;  // Excluded
+    if (tier->newest >= tier->ring.size())
+        first = std::max(first, tier->newest - tier->ring.size() + 1);
+    last = std::min(last, tier->newest + 1);
+    if (_max && last > first && last - first > _max)
+        last = first + _max;
+
+    series.resolution = tier->resolution;
+    series.start = first * tier->resolution;
+    for (uint64_t i = first; i < last; i++)
+    {
+        Period const& p = tier->ring[i % tier->ring.size()];
+        series.periods.push_back(p.index == i ? p.samples : std::vector<TelemetrySample>());
+    }
+    return series;
+}
+
+}  // namespace etc
+}  // namespace dev
@@ -0,0 +1,124 @@
+/*
+ This file is part of keccakminer.
+
+ keccakminer is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ keccakminer is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with keccakminer.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <libdevcore/Guards.h>
+
+namespace dev
+{
+namespace etc
+{
+/**
+ * @brief What a miner did during one period of a history
+ */
+struct TelemetrySample
+{
+    float hashrate = 0.0f;  // Average hashes per second
+    unsigned accepted = 0;  // Shares found during the period
+    unsigned rejected = 0;
+    unsigned failed = 0;
+    float tempC = 0.0f;     // Sensors averages
+    float fanP = 0.0f;
+    float powerW = 0.0f;
+    float switchMs = 0.0f;  // Longest job switch latency. 0 if none
+};
+
+/**
+ * @brief A tier of the history : one sample per miner every resolution
+ * seconds, kept for retention seconds
+ */
+struct TelemetryTier
+{
+    unsigned resolution;
+    unsigned retention;
+};
+
+/**
+ * @brief Consecutive periods out of a history. A period nothing was
+ * recorded for has no sample
+ */
+struct TelemetrySeries
+{
+    unsigned resolution = 0;
+    uint64_t start = 0;  // Unix time of first period
+    std::vector<std::vector<TelemetrySample>> periods;  // Samples by miner's index
+};
+
+/**
+ * @brief Fixed size time series of miners' telemetry.
+ * Each tier is a ring buffer allocated upfront. Coarser tiers are fed the
+ * same records and average them over their own resolution
+ * @threadsafe
+ */
+class TelemetryHistory
+{
+public:
+    TelemetryHistory(std::vector<TelemetryTier> const& _tiers);
+
+    /**
+     * @brief Parses "resolution:retention[,resolution:retention...]" in seconds.
+     * Each resolution must be a multiple of the previous one and divide its retention
+     * @throws std::invalid_argument on malformed spec
+     */
+    static std::vector<TelemetryTier> parse(std::string const& _spec);
+
+    /**
+     * @brief Resolution of the finest tier : how often to record. 0 when there's no tier
+     */
+    unsigned resolution() const;
+
+    /**
+     * @brief Records what miners did during the finest period ending at unix time _time
+     */
+    void record(uint64_t _time, std::vector<TelemetrySample> const& _samples);
+
+    /**
+     * @brief Periods overlapping [_from, _to) from the tier with the requested
+     * resolution (or the finest coarser one). With no resolution, from the finest
+     * tier still holding _from. At most _max periods
+     */
+    TelemetrySeries query(uint64_t _from, uint64_t _to, unsigned _resolution, unsigned _max) const;
+
+private:
+    struct Period
+    {
+        uint64_t index = 0;  // Unix time / resolution. 0 while unused
+        std::vector<TelemetrySample> samples;
+    };
+
+    struct Tier
+    {
+        unsigned resolution;
+        std::vector<Period> ring;  // Period of index i at i % ring.size()
+        Period pending;            // Being accumulated
+        unsigned records = 0;      // In pending
+        unsigned perPeriod = 1;    // Records making a full period
+        uint64_t newest = 0;       // Index of last closed period
+    };
+
+    void close(Tier& _tier);
+
+    mutable Mutex x_history;
+    std::vector<Tier> m_tiers;  // Finest first
+};
+
+}  // namespace etc
+}  // namespace dev
@@ -553,7 +553,7 @@ void EthGetworkClient::submitSolution(const Solution& solution)
         jReq["method"] = "eth_submitWork";
         jReq["params"] = Json::Value(Json::arrayValue);
         jReq["params"].append("0x" + nonceHex);
-        jReq["params"].append("0x" + solution.work.header.hex());
+        jReq["params"].append("0x" + solution.work->header.hex());
         jReq["params"].append("0x" + solution.mixHash.hex());
         send(jReq);
     }
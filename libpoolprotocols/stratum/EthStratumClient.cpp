@@ -1611,9 +1611,9 @@ void EthStratumClient::submitSolution(const Solution& solution)
 
         jReq["jsonrpc"] = "2.0";
         jReq["params"].append(m_conn->User());
-        jReq["params"].append(solution.work.job);
+        jReq["params"].append(solution.work->job);
         jReq["params"].append(toHex(solution.nonce, HexPrefix::Add));
-        jReq["params"].append(solution.work.header.hex(HexPrefix::Add));
+        jReq["params"].append(solution.work->header.hex(HexPrefix::Add));
         jReq["params"].append(solution.mixHash.hex(HexPrefix::Add));
         if (!m_conn->Workername().empty())
             jReq["worker"] = m_conn->Workername();
@@ -1624,7 +1624,7 @@ void EthStratumClient::submitSolution(const Solution& solution)
 
         jReq["method"] = "eth_submitWork";
         jReq["params"].append(toHex(solution.nonce, HexPrefix::Add));
-        jReq["params"].append(solution.work.header.hex(HexPrefix::Add));
+        jReq["params"].append(solution.work->header.hex(HexPrefix::Add));
         jReq["params"].append(solution.mixHash.hex(HexPrefix::Add));
         if (!m_conn->Workername().empty())
             jReq["worker"] = m_conn->Workername();
@@ -1634,16 +1634,16 @@ void EthStratumClient::submitSolution(const Solution& solution)
     case EthStratumClient::ETHEREUMSTRATUM:
 
         jReq["params"].append(m_conn->UserDotWorker());
-        jReq["params"].append(solution.work.job);
+        jReq["params"].append(solution.work->job);
         jReq["params"].append(
-            toHex(solution.nonce, HexPrefix::DontAdd).substr(solution.work.exSizeBytes));
+            toHex(solution.nonce, HexPrefix::DontAdd).substr(solution.work->exSizeBytes));
         break;
         
     case EthStratumClient::ETHEREUMSTRATUM2:
 
-        jReq["params"].append(solution.work.job);
+        jReq["params"].append(solution.work->job);
         jReq["params"].append(
-            toHex(solution.nonce, HexPrefix::DontAdd).substr(solution.work.exSizeBytes));
+            toHex(solution.nonce, HexPrefix::DontAdd).substr(solution.work->exSizeBytes));
         jReq["params"].append(m_session->workerId);
         break;        
     }
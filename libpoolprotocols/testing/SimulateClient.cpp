@@ -55,9 +55,10 @@ void SimulateClient::submitSolution(const Solution& solution)
 {
     // This is a fake submission only evaluated locally
     std::chrono::steady_clock::time_point submit_start = std::chrono::steady_clock::now();
-    bool accepted =
-        KeccakAux::eval(solution.work.header, solution.nonce).value <=
-        solution.work.boundary;
+    std::vector<uint64_t> passed;
+    KeccakAux::evalBatch(solution.work->header, solution.work->boundary,
+        vector_ref<const uint64_t>(&solution.nonce, 1), passed);
+    bool accepted = passed[0] & 1;
     std::chrono::milliseconds response_delay_ms =
         std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::steady_clock::now() - submit_start);